@@ -0,0 +1,262 @@
+// Micro- and macro-benchmarks of evaluate_object.cpp on seeded synthetic JRDB-like scenes:
+//
+//   g++ -O3 -std=c++17 -pthread -o benchmark_object benchmark_object.cpp
+//   ./benchmark_object [--boxes=10,50,100,500] [--frames=N] [--noise=S] [--scores=uniform|bimodal|ties]
+//                      [--dontcare=D] [--seed=S] [--min-time=SEC] [--threads=N] > results.csv
+//
+// One CSV row per benchmark and scene size is written to stdout, the evaluator's own messages are
+// discarded. Rows of different runs (e.g. before and after a change) can be joined on the
+// benchmark and scene columns.
+#define EVALUATE_OBJECT_LIBRARY
+#include "evaluate_object.cpp"
+
+#include <random>
+
+// parameters of the synthetic scenes
+struct tSceneConfig {
+  int32_t  n_boxes;   // pedestrians per frame
+  int32_t  n_frames;
+  double   noise;     // std. deviation of the detection position (m), sizes and yaw scale with it
+  string   scores;    // score distribution of the detections: uniform, bimodal or ties
+  double   dontcare;  // dontcare areas per pedestrian
+  uint32_t seed;
+  tSceneConfig () :
+    n_boxes(50), n_frames(200), noise(0.2), scores("uniform"), dontcare(0.05), seed(0) {}
+};
+
+// pedestrians around the sensor: uniformly placed within 30 m (beyond the hard level, so some are
+// ignored), each seen in the stitched 3760x480 image and detected with probability 0.9. Every
+// frame additionally gets 20% false positives and its dontcare areas.
+struct tScene {
+  tGroundtruthStore gt;
+  tDetectionStore   det;
+};
+
+void generateScene(const tSceneConfig &config, tScene &scene) {
+  mt19937_64 rng(config.seed);
+  uniform_real_distribution<double> unit(0, 1);
+  normal_distribution<double> normal(0, 1);
+  const double IMAGE_WIDTH = 3760, IMAGE_HEIGHT = 480, MAX_RANGE = 30;
+
+  // image box of a pedestrian standing at (t1, t3) with height h
+  auto imageBox = [&](double t1, double t3, double h, double &x1, double &y1, double &x2, double &y2) {
+    double dist = max(0.5, sqrt(t1*t1 + t3*t3));
+    double cx = (atan2(t1, t3) + M_PI) / (2*M_PI) * IMAGE_WIDTH;
+    double height = min(IMAGE_HEIGHT, 500 * h / dist);
+    x1 = cx - 0.2*height; x2 = cx + 0.2*height;
+    y1 = IMAGE_HEIGHT/2 - height/2; y2 = IMAGE_HEIGHT/2 + height/2;
+  };
+  auto score = [&]() {
+    if (config.scores == "bimodal")
+      return unit(rng) < 0.5 ? 0.05 + 0.2*unit(rng) : 0.7 + 0.3*unit(rng);
+    if (config.scores == "ties")
+      return floor(unit(rng) * 10) / 10;
+    return unit(rng);
+  };
+
+  vector<tGroundtruth> gt_frame;
+  vector<tDetection> det_frame;
+  for (int32_t f = 0; f < config.n_frames; f++) {
+    for (int32_t i = 0; i < config.n_boxes; i++) {
+      double r = MAX_RANGE * sqrt(unit(rng)), phi = 2*M_PI*unit(rng);
+      tGroundtruth g(tBox(PEDESTRIAN, 0, 0, 0, 0, 0), 0, (int32_t)(unit(rng)*4));
+      g.t1 = r*cos(phi); g.t3 = r*sin(phi); g.t2 = 0.8 + 0.05*normal(rng);
+      g.l = 0.5 + 0.3*unit(rng); g.w = 0.4 + 0.3*unit(rng); g.h = 1.5 + 0.4*unit(rng);
+      g.ry = 2*M_PI*unit(rng);
+      g.num_points_3d = (int32_t)(2000 / (1 + r*r/4));
+      imageBox(g.t1, g.t3, g.h, g.box.x1, g.box.y1, g.box.x2, g.box.y2);
+      g.box.alpha = g.ry;
+      gt_frame.push_back(g);
+
+      if (unit(rng) < 0.9) {
+        tDetection d(tBox(PEDESTRIAN, 0, 0, 0, 0, 0), score());
+        d.t1 = g.t1 + config.noise*normal(rng); d.t3 = g.t3 + config.noise*normal(rng);
+        d.t2 = g.t2 + 0.5*config.noise*normal(rng);
+        d.l = max(0.1, g.l*(1 + config.noise*normal(rng))); d.w = max(0.1, g.w*(1 + config.noise*normal(rng)));
+        d.h = max(0.1, g.h*(1 + config.noise*normal(rng)));
+        d.ry = g.ry + config.noise*normal(rng);
+        imageBox(d.t1, d.t3, d.h, d.box.x1, d.box.y1, d.box.x2, d.box.y2);
+        d.box.alpha = d.ry;
+        det_frame.push_back(d);
+      }
+    }
+
+    // false positives anywhere in range
+    for (int32_t i = 0; i < config.n_boxes / 5; i++) {
+      double r = MAX_RANGE * sqrt(unit(rng)), phi = 2*M_PI*unit(rng);
+      tDetection d(tBox(PEDESTRIAN, 0, 0, 0, 0, 0), score());
+      d.t1 = r*cos(phi); d.t3 = r*sin(phi); d.t2 = 0.8;
+      d.l = 0.6; d.w = 0.5; d.h = 1.7; d.ry = 2*M_PI*unit(rng);
+      imageBox(d.t1, d.t3, d.h, d.box.x1, d.box.y1, d.box.x2, d.box.y2);
+      det_frame.push_back(d);
+    }
+
+    // dontcare areas
+    for (int32_t i = 0; i < (int32_t)(config.dontcare * config.n_boxes + unit(rng)); i++) {
+      double r = MAX_RANGE * sqrt(unit(rng)), phi = 2*M_PI*unit(rng);
+      tGroundtruth g(tBox(DONTCARE_ID, 0, 0, 0, 0, 0), 0, 0);
+      g.t1 = r*cos(phi); g.t3 = r*sin(phi); g.t2 = 0.8;
+      g.l = 2; g.w = 2; g.h = 2; g.ry = 0; g.num_points_3d = 0;
+      imageBox(g.t1, g.t3, 3, g.box.x1, g.box.y1, g.box.x2, g.box.y2);
+      gt_frame.push_back(g);
+    }
+
+    scene.gt.append(gt_frame);
+    scene.det.append(det_frame);
+  }
+}
+
+// runs fn (which performs ops operations) until min_time has passed and writes its time per
+// operation as one CSV row
+template <typename F>
+void bench(ostream &out, const string &name, const tSceneConfig &config, double min_time, F fn) {
+  int64_t iterations = 0, ops = 0;
+  auto start = chrono::steady_clock::now();
+  do {
+    ops += fn();
+    iterations++;
+  } while (secondsSince(start) < min_time);
+  double seconds = secondsSince(start);
+  out << name << ',' << config.n_boxes << ',' << config.n_frames << ',' << config.noise << ','
+      << config.scores << ',' << config.dontcare << ',' << config.seed << ','
+      << iterations << ',' << ops << ',' << seconds * 1e9 / max((int64_t)1, ops) << endl;
+}
+
+// keeps results alive so the timed calls are not optimized away
+volatile double sink;
+
+void runBenchmarks(ostream &out, const tSceneConfig &config, double min_time, int32_t n_threads) {
+  tScene scene;
+  generateScene(config, scene);
+
+  // overlaps of every ground truth with the detections of its frame, as the evaluation pairs them
+  auto allPairs = [&](double (*boxoverlap)(const tDetection&, const tGroundtruth&, int32_t)) {
+    return [&, boxoverlap]() {
+      double s = 0;
+      int64_t ops = 0;
+      for (size_t f = 0; f < scene.gt.size(); f++) {
+        tSpan<tGroundtruth> gt = scene.gt[f];
+        tSpan<tDetection> det = scene.det[f];
+        for (const tGroundtruth &g : gt)
+          for (const tDetection &d : det)
+            s += boxoverlap(d, g, -1);
+        ops += gt.size() * det.size();
+      }
+      sink = s;
+      return ops;
+    };
+  };
+  bench(out, "imageBoxOverlap", config, min_time, allPairs(imageBoxOverlap));
+  bench(out, "groundBoxOverlap", config, min_time, allPairs(groundBoxOverlap));
+  bench(out, "box3DOverlap", config, min_time, allPairs(box3DOverlap));
+  bench(out, "centerOverlap", config, min_time, allPairs(centerOverlap));
+
+  bench(out, "toPolygon", config, min_time, [&]() {
+    double s = 0;
+    for (const tGroundtruth &g : scene.gt.boxes)
+      s += toPolygon(g).outer()[0].x();
+    sink = s;
+    return (int64_t)scene.gt.boxes.size();
+  });
+
+  // per-frame matching of the 3D evaluation on the hard level, one op is one frame
+  vector< vector<int32_t> > ignored_gt(scene.gt.size()), ignored_det(scene.gt.size());
+  vector< vector<tGroundtruth> > dc(scene.gt.size());
+  for (size_t f = 0; f < scene.gt.size(); f++) {
+    vector<int32_t> dc_index;
+    int32_t n_gt = 0;
+    cleanGroundtruth(PEDESTRIAN, scene.gt[f], ignored_gt[f], dc_index, n_gt, HARD, true);
+    cleanDetections(PEDESTRIAN, scene.det[f], ignored_det[f], HARD, true);
+    for (int32_t i : dc_index)
+      dc[f].push_back(scene.gt[f][i]);
+  }
+  bench(out, "computeStatistics", config, min_time, [&]() {
+    double s = 0;
+    for (size_t f = 0; f < scene.gt.size(); f++)
+      s += computeStatistics(PEDESTRIAN, scene.gt[f], scene.det[f], dc[f], ignored_gt[f], ignored_det[f],
+                             true, box3DOverlap, BOX3D, false, 0.5).tp;
+    sink = s;
+    return (int64_t)scene.gt.size();
+  });
+
+  // recall discretization of all detection scores, one op is one call
+  vector<double> scores;
+  for (const tDetection &d : scene.det.boxes)
+    scores.push_back(d.thresh);
+  bench(out, "getThresholds", config, min_time, [&]() {
+    vector<double> v(scores);
+    sink = getThresholds(v, scene.gt.boxes.size()).size();
+    return (int64_t)1;
+  });
+
+  // whole evaluation of the scene (cleaning, overlaps, recall and precision passes), one op is one run
+  bench(out, "eval_class_3d", config, min_time, [&]() {
+    vector<double> precision, recall;
+    eval_class(PEDESTRIAN, scene.gt, scene.det, false, box3DOverlap, precision, recall, BOX3D, HARD, true, false, n_threads);
+    sink = precision.empty() ? 0 : precision[0];
+    return (int64_t)1;
+  });
+  bench(out, "eval_class_center", config, min_time, [&]() {
+    vector<double> precision, recall;
+    eval_class(PEDESTRIAN, scene.gt, scene.det, false, centerOverlap, precision, recall, CENTER, HARD, true, false, n_threads);
+    sink = precision.empty() ? 0 : precision[0];
+    return (int64_t)1;
+  });
+  bench(out, "eval_class_2d", config, min_time, [&]() {
+    vector<double> precision;
+    eval_class(PEDESTRIAN, scene.gt, scene.det, false, imageBoxOverlap, precision, IMAGE, HARD, false, n_threads);
+    sink = precision[0];
+    return (int64_t)1;
+  });
+}
+
+int32_t main (int32_t argc, char *argv[]) {
+  initGlobals();
+
+  tSceneConfig config;
+  vector<int32_t> boxes = {10, 50, 100, 500};
+  double min_time = 0.5;
+  int32_t n_threads = max(1, (int32_t)thread::hardware_concurrency());
+  for (int32_t k = 1; k < argc; k++) {
+    if (!strncmp(argv[k], "--boxes=", 8)) {
+      boxes.clear();
+      istringstream list(argv[k] + 8);
+      string n;
+      while (getline(list, n, ','))
+        if (atoi(n.c_str()) > 0)
+          boxes.push_back(atoi(n.c_str()));
+    } else if (!strncmp(argv[k], "--frames=", 9) && atoi(argv[k] + 9) > 0) {
+      config.n_frames = atoi(argv[k] + 9);
+    } else if (!strncmp(argv[k], "--noise=", 8)) {
+      config.noise = atof(argv[k] + 8);
+    } else if (!strncmp(argv[k], "--scores=", 9) &&
+               (!strcmp(argv[k] + 9, "uniform") || !strcmp(argv[k] + 9, "bimodal") || !strcmp(argv[k] + 9, "ties"))) {
+      config.scores = argv[k] + 9;
+    } else if (!strncmp(argv[k], "--dontcare=", 11)) {
+      config.dontcare = atof(argv[k] + 11);
+    } else if (!strncmp(argv[k], "--seed=", 7)) {
+      config.seed = strtoul(argv[k] + 7, NULL, 10);
+    } else if (!strncmp(argv[k], "--min-time=", 11)) {
+      min_time = atof(argv[k] + 11);
+    } else if (!strncmp(argv[k], "--threads=", 10) && atoi(argv[k] + 10) > 0) {
+      n_threads = atoi(argv[k] + 10);
+    } else {
+      cerr << "Unknown option " << argv[k] << endl;
+      return 1;
+    }
+  }
+
+  // the results go to stdout, the progress messages of the evaluation are dropped
+  ostream out(cout.rdbuf());
+  ostringstream discard;
+  cout.rdbuf(discard.rdbuf());
+
+  out << "benchmark,boxes,frames,noise,scores,dontcare,seed,iterations,ops,ns_per_op" << endl;
+  for (int32_t n : boxes) {
+    config.n_boxes = n;
+    runBenchmarks(out, config, min_time, n_threads);
+    discard.str("");
+  }
+  cout.rdbuf(out.rdbuf());
+  return 0;
+}
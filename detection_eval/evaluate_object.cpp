@@ -11,11 +11,28 @@
 #include <stdexcept>
 #include <filesystem>
 #include <iomanip>  // std::setprecision()
+#include <sstream>
+#include <charconv> // std::from_chars()
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <limits>
+#include <random>
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
 
 #include <boost/numeric/ublas/matrix.hpp>
-#include <boost/numeric/ublas/io.hpp>
 
 #include <boost/geometry.hpp>
 #include <boost/geometry/geometries/point_xy.hpp>
@@ -42,8 +59,13 @@ const int32_t MIN_3D_N_POINTS = 10;
 const double MAX_3D_DIST[2] = {15, 25};
 const double MIN_2D_AREA[2] = {1600, 500};
 const double MAX_2D_OCC = 2;
-// evaluation metrics: image, ground or 3D
-enum METRIC{IMAGE=0, GROUND=1, BOX3D=2};
+// evaluation metrics: image, ground, 3D or ground plane center distance
+enum METRIC{IMAGE=0, GROUND=1, BOX3D=2, CENTER=3};
+
+// center distance thresholds (m) of the CENTER metric, one per overlap column. Its overlap is
+// 1 - distance/CENTER_MAX_DIST, so pairs further apart than the largest threshold never match.
+const double CENTER_DIST[3] = {2, 1, 0.5};
+const double CENTER_MAX_DIST = 2;
 
 // evaluated object classes
 enum CLASSES{CAR=0, PEDESTRIAN=1, CYCLIST=2};
@@ -54,7 +76,8 @@ vector<string> CLASS_NAMES;
 vector<string> CLASS_NAMES_CAP;
 // the minimum overlap required for 2D evaluation on the image/ground plane and 3D evaluation
 //const double MIN_OVERLAP[3][3] = {{0.5, 0.5, 0.5}, {0.5, 0.5, 0.5}, {0.5, 0.5, 0.5}};
-const double MIN_OVERLAP[3][3] = {{0.3, 0.5, 0.7}, {0.3, 0.5, 0.7}, {0.3, 0.5, 0.7}};
+const double MIN_OVERLAP[4][3] = {{0.3, 0.5, 0.7}, {0.3, 0.5, 0.7}, {0.3, 0.5, 0.7},
+                                  {1 - CENTER_DIST[0]/CENTER_MAX_DIST, 1 - CENTER_DIST[1]/CENTER_MAX_DIST, 1 - CENTER_DIST[2]/CENTER_MAX_DIST}};
 
 // no. of recall steps that should be evaluated (discretized)
 const double N_SAMPLE_PTS = 41;
@@ -63,14 +86,17 @@ const double N_SAMPLE_PTS = 41;
 map<size_t, string> gtdetidx_to_frame_map;
 /* END STAT LOGGING */
 
-// initialize class names
+// initialize class names, once even if evaluators are created on several threads
 void initGlobals () {
-  CLASS_NAMES.push_back("car");
-  CLASS_NAMES.push_back("pedestrian");
-  CLASS_NAMES.push_back("cyclist");
-  CLASS_NAMES_CAP.push_back("Car");
-  CLASS_NAMES_CAP.push_back("Pedestrian");
-  CLASS_NAMES_CAP.push_back("Cyclist");
+  static once_flag initialized;
+  call_once(initialized, []() {
+    CLASS_NAMES.push_back("car");
+    CLASS_NAMES.push_back("pedestrian");
+    CLASS_NAMES.push_back("cyclist");
+    CLASS_NAMES_CAP.push_back("Car");
+    CLASS_NAMES_CAP.push_back("Pedestrian");
+    CLASS_NAMES_CAP.push_back("Cyclist");
+  });
 }
 
 /*=======================================================================
@@ -88,16 +114,80 @@ struct tPrData {
     similarity(0), tp(0), fp(0), fn(0) {}
 };
 
+// object types are interned into small ids when labels are loaded, so boxes carry no strings and
+// are compared by id. Names are matched case-insensitively (as by strcasecmp), the first ids are
+// fixed: CLASSES, followed by the types cleanData treats specially.
+typedef uint8_t tClassId;
+const tClassId PERSON_SITTING_ID = 3;
+const tClassId VAN_ID            = 4;
+const tClassId DONTCARE_ID       = 5;
+const tClassId INVALID_ID        = 6;
+
+struct tClassTable {
+  mutex                 m;
+  vector<string>        names; // lower case name of every id
+  map<string, tClassId> ids;
+  tClassTable () {
+    const char *fixed[] = {"car", "pedestrian", "cyclist", "person_sitting", "van", "dontcare", "invalid"};
+    for (const char *name : fixed) {
+      ids[name] = names.size();
+      names.push_back(name);
+    }
+  }
+};
+
+inline tClassTable& classTable() {
+  static tClassTable table;
+  return table;
+}
+
+// id of the object type [b, e), new types are added on first use. Ids never change, so every
+// thread keeps the ones it has seen and only locks the table for a type new to it.
+tClassId internClass(const char *b, const char *e) {
+  thread_local map<string, tClassId> seen;
+  string name(b, e);
+  for (char &ch : name)
+    ch = tolower((unsigned char)ch);
+  auto it = seen.find(name);
+  if (it != seen.end())
+    return it->second;
+
+  tClassTable &table = classTable();
+  lock_guard<mutex> lock(table.m);
+  it = table.ids.find(name);
+  if (it == table.ids.end()) {
+    if (table.names.size() > numeric_limits<tClassId>::max())
+      throw invalid_argument("too many object types, cannot intern " + name);
+    it = table.ids.insert(make_pair(name, (tClassId)table.names.size())).first;
+    table.names.push_back(name);
+  }
+  seen[name] = it->second;
+  return it->second;
+}
+
+inline tClassId internClass(const string &name) {
+  return internClass(name.data(), name.data() + name.size());
+}
+
+// lower case name of an interned object type
+string className(tClassId id) {
+  tClassTable &table = classTable();
+  lock_guard<mutex> lock(table.m);
+  return table.names[id];
+}
+
 // holding bounding boxes for ground truth and detections
 struct tBox {
-  string  type;     // object type as car, pedestrian or cyclist,...
+  tClassId type;    // interned object type as car, pedestrian or cyclist,...
   double   x1;      // left corner
   double   y1;      // top corner
   double   x2;      // right corner
   double   y2;      // bottom corner
   double   alpha;   // image orientation
-  tBox (string type, double x1,double y1,double x2,double y2,double alpha) :
+  tBox (tClassId type, double x1,double y1,double x2,double y2,double alpha) :
     type(type),x1(x1),y1(y1),x2(x2),y2(y2),alpha(alpha) {}
+  tBox (string type, double x1,double y1,double x2,double y2,double alpha) :
+    type(internClass(type)),x1(x1),y1(y1),x2(x2),y2(y2),alpha(alpha) {}
 };
 
 // holding ground truth data
@@ -110,7 +200,7 @@ struct tGroundtruth {
   double  t1, t2, t3;
   double h, w, l;
   tGroundtruth () :
-    box(tBox("invalild",-1,-1,-1,-1,-10)),truncation(-1),occlusion(-1) {}
+    box(tBox(INVALID_ID,-1,-1,-1,-1,-10)),truncation(-1),occlusion(-1) {}
   tGroundtruth (tBox box,int32_t truncation,int32_t occlusion) :
     box(box),truncation(truncation),occlusion(occlusion) {}
   tGroundtruth (string type,double x1,double y1,double x2,double y2,double alpha,int32_t truncation,int32_t occlusion) :
@@ -125,7 +215,7 @@ struct tDetection {
   double  t1, t2, t3;
   double  h, w, l;
   tDetection ():
-    box(tBox("invalid",-1,-1,-1,-1,-10)),thresh(-1000) {}
+    box(tBox(INVALID_ID,-1,-1,-1,-1,-10)),thresh(-1000) {}
   tDetection (tBox box,double thresh) :
     box(box),thresh(thresh) {}
   tDetection (string type,double x1,double y1,double x2,double y2,double alpha,double thresh) :
@@ -133,57 +223,625 @@ struct tDetection {
 };
 
 
+// non-owning view of consecutive boxes, e.g. of one frame or of all frames of a sequence
+template <typename T>
+struct tSpan {
+  const T *first;
+  size_t   n;
+  tSpan () : first(NULL), n(0) {}
+  tSpan (const T *first, size_t n) : first(first), n(n) {}
+  const T* begin () const { return first; }
+  const T* end () const { return first + n; }
+  size_t size () const { return n; }
+  bool empty () const { return n == 0; }
+  const T& operator[] (size_t i) const { return first[i]; }
+};
+
+// owns the boxes of all frames in one contiguous arena, frame i is boxes[offset[i], offset[i+1]).
+// Frames, sequences (ranges of frames) and the whole set are handed out as spans into it.
+template <typename T>
+struct tFrameStore {
+  vector<T>      boxes;
+  vector<size_t> offset;
+  tFrameStore () : offset(1, 0) {}
+  size_t size () const { return offset.size() - 1; }
+  tSpan<T> operator[] (size_t i) const { return frames(i, i + 1); }
+  // boxes of the frames [begin, end)
+  tSpan<T> frames (size_t begin, size_t end) const {
+    return tSpan<T>(boxes.data() + offset[begin], offset[end] - offset[begin]);
+  }
+  void clear () {
+    vector<T>().swap(boxes);
+    offset.assign(1, 0);
+  }
+  // moves the boxes of a frame into the arena and releases them
+  void append (vector<T> &frame) {
+    move(frame.begin(), frame.end(), back_inserter(boxes));
+    vector<T>().swap(frame);
+    offset.push_back(boxes.size());
+  }
+};
+
+typedef tFrameStore<tGroundtruth> tGroundtruthStore;
+typedef tFrameStore<tDetection>   tDetectionStore;
+
+// box indices of many frames in compressed rows, frame i is index[offset[i], offset[i+1])
+struct tIndexRows {
+  vector<int32_t> index;
+  vector<size_t>  offset;
+  tIndexRows () : offset(1, 0) {}
+  size_t size () const { return offset.size() - 1; }
+  tSpan<int32_t> operator[] (size_t i) const {
+    return tSpan<int32_t>(index.data() + offset[i], offset[i + 1] - offset[i]);
+  }
+  // closes the row of the current frame after its indices were pushed to index
+  void closeRow () { offset.push_back(index.size()); }
+  // appends all rows of another set behind the rows of this one
+  void append (const tIndexRows &rows) {
+    const size_t base = index.size();
+    index.insert(index.end(), rows.index.begin(), rows.index.end());
+    for (size_t i = 1; i < rows.offset.size(); i++)
+      offset.push_back(base + rows.offset[i]);
+  }
+};
+
+// TP/FP/FN indices of all frames, captured only at the requested threshold indices
+struct tIndexCapture {
+  vector<int32_t>    thres_idx;  // requested threshold indices, ascending
+  vector<tIndexRows> tp, fp, fn; // one set of rows per requested threshold
+  tIndexCapture () {}
+  explicit tIndexCapture (const vector<int32_t> &thres_idx) :
+    thres_idx(thres_idx), tp(thres_idx.size()), fp(thres_idx.size()), fn(thres_idx.size()) {}
+  // position of threshold index t in thres_idx, or -1 if it is not captured
+  int32_t slot (int32_t t) const {
+    auto it = lower_bound(thres_idx.begin(), thres_idx.end(), t);
+    return it != thres_idx.end() && *it == t ? int32_t(it - thres_idx.begin()) : -1;
+  }
+  void append (const tIndexCapture &capture) {
+    for (size_t k = 0; k < thres_idx.size(); k++) {
+      tp[k].append(capture.tp[k]);
+      fp[k].append(capture.fp[k]);
+      fn[k].append(capture.fn[k]);
+    }
+  }
+};
+
+// command line options of an evaluation run
+struct tEvalOptions {
+  bool    use_cache;  // read/write binary label caches
+  int32_t n_threads;  // worker threads
+  bool    all_levels; // evaluate all overlap thresholds and difficulties
+  bool    batch;      // evaluate a list of prediction directories against one ground truth
+  string  export_path; // single archive for the tp/fp/fn boxes instead of files per frame
+  bool    json;       // read JRDB JSON label files instead of converted label trees
+  bool    ospa;       // add the OSPA of the valid boxes to every row
+  int32_t bootstrap;  // no. of resamples for the confidence interval of the overall row, 0: none
+  bool    bootstrap_sequences; // resample whole sequences instead of frames
+  uint32_t seed;      // seed of the resamples
+  string  profile_path; // Chrome trace of the run, with a summary table on stdout
+  int32_t verify;     // frames checked against the reference evaluation, 0: all, -1: none
+  bool    center;     // 3D: match on the ground plane center distance (CENTER) instead of the 3D IoU
+  tEvalOptions () :
+    use_cache(false), n_threads(max(1, (int32_t)thread::hardware_concurrency())), all_levels(false), batch(false),
+    json(false), ospa(false), bootstrap(0), bootstrap_sequences(false), seed(0), verify(-1), center(false) {}
+};
+
+/*=======================================================================
+PROFILING
+=======================================================================*/
+
+// stage timers and counters of one run, written as a Chrome trace and a summary table (--profile).
+// Every thread records into its own buffer, so a timer costs two clock reads while profiling and
+// one branch otherwise. Per-frame events carry the frame index, which the summary resolves to
+// <sequence>/<frame> to find the frames and sequences that dominate the runtime.
+struct tTraceEvent {
+  const char *name;      // static string
+  string      detail;    // shown as args.detail, e.g. a sequence
+  int64_t     frame;     // frame index or -1
+  int64_t     begin_us, dur_us;
+};
+
+class tProfiler {
+public:
+  static tProfiler &get () {
+    static tProfiler profiler;
+    return profiler;
+  }
+
+  bool enabled () const { return on; }
+  void enable () {
+    on = true;
+    origin = chrono::steady_clock::now();
+  }
+
+  // trace thread of the calling thread, set by parallelFor for its workers
+  static int32_t &threadSlot () {
+    static thread_local int32_t slot = -1;
+    return slot;
+  }
+
+  // names of the frames, indexed as the frames of the evaluation
+  void setFrames (const vector<string> &names) {
+    lock_guard<mutex> lock(m);
+    frame_names = names;
+  }
+
+  int64_t now () const {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - origin).count();
+  }
+
+  void record (const char *name, string detail, int64_t frame, int64_t begin_us) {
+    buffer().events.push_back(tTraceEvent{name, move(detail), frame, begin_us, now() - begin_us});
+  }
+
+  // counters are summed over all threads, peaks take the maximum
+  void count (const string &name, int64_t n) {
+    if (on)
+      buffer().counters[name] += n;
+  }
+  void peak (const string &name, int64_t n) {
+    if (on) {
+      int64_t &p = buffer().peaks[name];
+      p = max(p, n);
+    }
+  }
+
+  // peak resident set size of the process
+  static double peakRssMB () {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0; // kB on Linux
+  }
+
+  void writeTrace (const string &path) const;
+  void writeSummary (ostream &out) const;
+
+private:
+  struct tThreadBuffer {
+    int32_t                tid;
+    vector<tTraceEvent>    events;
+    map<string, int64_t>   counters, peaks;
+    vector<pair<int64_t, double> > rss; // (time, MB) at the end of every stage
+  };
+
+  tProfiler () :
+    on(false), n_other(0) {}
+
+  tThreadBuffer &buffer () {
+    static thread_local tThreadBuffer *local = NULL;
+    if (!local) {
+      lock_guard<mutex> lock(m);
+      buffers.push_back(unique_ptr<tThreadBuffer>(new tThreadBuffer()));
+      local = buffers.back().get();
+      // workers are traced by their slot, the main thread as 0 and other threads after them
+      int32_t slot = threadSlot();
+      local->tid = slot >= 0 ? slot : (n_other++ == 0 ? 0 : 1000 + n_other);
+    }
+    return *local;
+  }
+
+  friend class tScopedTimer;
+
+  bool                              on;
+  chrono::steady_clock::time_point  origin;
+  mutable mutex                     m;
+  vector<unique_ptr<tThreadBuffer> > buffers;
+  vector<string>                    frame_names;
+  int32_t                           n_other;
+};
+
+// times its scope; stages also sample the peak RSS when they end
+class tScopedTimer {
+public:
+  explicit tScopedTimer (const char *name) :
+    name(name), frame(-1), stage(true) { start(); }
+  tScopedTimer (const char *name, const string &detail) :
+    name(name), frame(-1), stage(true) {
+    if (tProfiler::get().enabled())
+      this->detail = detail;
+    start();
+  }
+  // one frame of a pass
+  tScopedTimer (const char *name, size_t frame) :
+    name(name), frame(frame), stage(false) { start(); }
+  ~tScopedTimer () {
+    if (begin_us < 0)
+      return;
+    tProfiler &profiler = tProfiler::get();
+    profiler.record(name, move(detail), frame, begin_us);
+    if (stage)
+      profiler.buffer().rss.push_back(make_pair(profiler.now(), tProfiler::peakRssMB()));
+  }
+
+private:
+  void start () {
+    begin_us = tProfiler::get().enabled() ? tProfiler::get().now() : -1;
+  }
+
+  const char *name;
+  string      detail;
+  int64_t     frame;
+  bool        stage;
+  int64_t     begin_us;
+};
+
+inline void writeJsonString (ostream &out, const string &s) {
+  out << '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      out << '\\' << c;
+    else if ((unsigned char)c < 0x20)
+      out << "\\u" << hex << setw(4) << setfill('0') << (int)c << dec << setfill(' ');
+    else
+      out << c;
+  }
+  out << '"';
+}
+
+// Chrome trace event format, readable by chrome://tracing and Perfetto
+void tProfiler::writeTrace (const string &path) const {
+  lock_guard<mutex> lock(m);
+  ofstream out(path);
+  if (!out)
+    throw runtime_error("Cannot write trace " + path);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  auto next = [&]() -> ostream& {
+    if (!first)
+      out << ",\n";
+    first = false;
+    return out;
+  };
+  set<int32_t> tids;
+  for (const auto &b : buffers) {
+    tids.insert(b->tid);
+    for (const tTraceEvent &e : b->events) {
+      next() << "{\"name\":";
+      writeJsonString(out, e.name);
+      out << ",\"cat\":\"" << (e.frame >= 0 ? "frame" : "stage") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid
+          << ",\"ts\":" << e.begin_us << ",\"dur\":" << e.dur_us;
+      if (e.frame >= 0 || !e.detail.empty()) {
+        out << ",\"args\":{";
+        if (e.frame >= 0) {
+          out << "\"frame\":";
+          writeJsonString(out, (size_t)e.frame < frame_names.size() ? frame_names[e.frame] : to_string(e.frame));
+        } else {
+          out << "\"detail\":";
+          writeJsonString(out, e.detail);
+        }
+        out << '}';
+      }
+      out << '}';
+    }
+    for (const auto &sample : b->rss)
+      next() << "{\"name\":\"peak RSS (MB)\",\"ph\":\"C\",\"pid\":1,\"ts\":" << sample.first
+             << ",\"args\":{\"MB\":" << sample.second << "}}";
+  }
+  for (int32_t tid : tids) {
+    next() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":\""
+           << (tid == 0 ? "main" : tid < 1000 ? "worker " + to_string(tid) : "background") << "\"}}";
+  }
+  out << "\n]}\n";
+}
+
+// time per stage, counters, peak RSS and the slowest frames and sequences
+void tProfiler::writeSummary (ostream &out) const {
+  lock_guard<mutex> lock(m);
+  struct tStage { int64_t calls, total_us, max_us; };
+  map<string, tStage> stages;
+  map<string, int64_t> counters, peaks;
+  map<int64_t, int64_t> frame_us;
+  for (const auto &b : buffers) {
+    for (const tTraceEvent &e : b->events) {
+      tStage &s = stages[e.frame >= 0 ? string(e.name) + " (per frame)" : string(e.name)];
+      s.calls++;
+      s.total_us += e.dur_us;
+      s.max_us = max(s.max_us, e.dur_us);
+      if (e.frame >= 0)
+        frame_us[e.frame] += e.dur_us;
+    }
+    for (const auto &c : b->counters)
+      counters[c.first] += c.second;
+    for (const auto &p : b->peaks)
+      peaks[p.first] = max(peaks[p.first], p.second);
+  }
+
+  out << "Profile" << endl;
+  out << left << setw(44) << "stage" << right << setw(10) << "calls" << setw(12) << "total s"
+      << setw(12) << "mean ms" << setw(12) << "max ms" << endl;
+  for (const auto &s : stages)
+    out << left << setw(44) << s.first << right << setw(10) << s.second.calls << fixed << setprecision(3)
+        << setw(12) << s.second.total_us / 1e6 << setw(12) << s.second.total_us / 1e3 / s.second.calls
+        << setw(12) << s.second.max_us / 1e3 << defaultfloat << endl;
+  for (const auto &c : counters)
+    out << left << setw(44) << c.first << right << setw(10) << c.second << endl;
+  for (const auto &p : peaks)
+    out << left << setw(44) << p.first << right << setw(10) << p.second << endl;
+  out << left << setw(44) << "peak RSS (MB)" << right << setw(10) << fixed << setprecision(1) << peakRssMB() << defaultfloat << endl;
+
+  // frames and sequences by the time of their per-frame events
+  vector<pair<int64_t, string> > frames;
+  map<string, int64_t> sequences;
+  for (const auto &f : frame_us) {
+    string name = (size_t)f.first < frame_names.size() ? frame_names[f.first] : to_string(f.first);
+    frames.push_back(make_pair(f.second, name));
+    sequences[name.substr(0, name.find('/'))] += f.second;
+  }
+  vector<pair<int64_t, string> > seqs;
+  for (const auto &s : sequences)
+    seqs.push_back(make_pair(s.second, s.first));
+  for (auto *list : {&frames, &seqs}) {
+    sort(list->begin(), list->end(), greater<pair<int64_t, string> >());
+    out << (list == &frames ? "slowest frames" : "slowest sequences") << " (ms in per-frame passes)" << endl;
+    for (size_t k = 0; k < min((size_t)10, list->size()); k++)
+      out << "  " << left << setw(56) << (*list)[k].second << right << fixed << setprecision(3)
+          << setw(12) << (*list)[k].first / 1e3 << defaultfloat << endl;
+  }
+}
+
+/*=======================================================================
+PARALLEL EXECUTION
+=======================================================================*/
+
+// runs fn(i) for all i in [0, n) on up to n_threads threads (the calling thread included). Every
+// thread starts with its own contiguous block of indices and takes them from the front; a thread
+// that ran out steals the back half of the largest remaining block. The first exception is
+// rethrown after all threads joined.
+template <typename F>
+void parallelFor(size_t n, int32_t n_threads, F fn) {
+  const size_t n_workers = max((size_t)1, min((size_t)max(n_threads, 1), n));
+  struct tBlock {
+    mutex  m;
+    size_t begin, end;
+  };
+  vector<tBlock> blocks(n_workers);
+  for (size_t w = 0; w < n_workers; w++) {
+    blocks[w].begin = n * w / n_workers;
+    blocks[w].end = n * (w + 1) / n_workers;
+  }
+  atomic<bool> failed(false);
+  exception_ptr error;
+  mutex error_mutex;
+
+  auto worker = [&](size_t w) {
+    if (w > 0)
+      tProfiler::threadSlot() = (int32_t)w;
+    tBlock &own = blocks[w];
+    while (!failed) {
+      size_t i = n;
+      {
+        lock_guard<mutex> lock(own.m);
+        if (own.begin < own.end)
+          i = own.begin++;
+      }
+      if (i == n) {
+        // steal from the victim with the most remaining work
+        size_t victim = n_workers, remaining = 0;
+        for (size_t v = 0; v < n_workers; v++) {
+          lock_guard<mutex> lock(blocks[v].m);
+          if (blocks[v].end - blocks[v].begin > remaining) {
+            victim = v;
+            remaining = blocks[v].end - blocks[v].begin;
+          }
+        }
+        if (victim == n_workers)
+          break;
+        {
+          lock_guard<mutex> lock(blocks[victim].m);
+          size_t left = blocks[victim].end - blocks[victim].begin;
+          if (left == 0)
+            continue;
+          size_t mid = blocks[victim].end - (left + 1) / 2;
+          i = mid;
+          lock_guard<mutex> own_lock(own.m);
+          own.begin = mid + 1;
+          own.end = blocks[victim].end;
+          blocks[victim].end = mid;
+        }
+      }
+      try {
+        fn(i);
+      } catch (...) {
+        lock_guard<mutex> lock(error_mutex);
+        if (!error)
+          error = current_exception();
+        failed = true;
+      }
+    }
+  };
+  vector<thread> pool;
+  for (size_t w = 1; w < n_workers; w++)
+    pool.emplace_back(worker, w);
+  worker(0);
+  for (auto &t : pool)
+    t.join();
+  if (error)
+    rethrow_exception(error);
+}
+
+// seconds since start
+inline double secondsSince(chrono::steady_clock::time_point start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
 /*=======================================================================
 FUNCTIONS TO LOAD DETECTION AND GROUND TRUTH DATA ONCE, SAVE RESULTS
 =======================================================================*/
+
+// read-only memory mapping of a label file
+struct tMappedFile {
+  const char *data;
+  size_t      size;
+  tMappedFile (const string &file_name, const string &what) : data(NULL), size(0) {
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw invalid_argument("cannot read " + what + " file " + file_name);
+    // only an empty file has no boxes, a file that cannot be mapped is an error
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      throw invalid_argument("cannot read " + what + " file " + file_name + " (fstat failed)");
+    }
+    if (st.st_size > 0) {
+      void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        close(fd);
+        throw invalid_argument("cannot read " + what + " file " + file_name + " (mmap failed)");
+      }
+      data = (const char*)p;
+      size = st.st_size;
+    }
+    close(fd);
+  }
+  ~tMappedFile () {
+    if (data)
+      munmap((void*)data, size);
+  }
+};
+
+// scans label text with the conversion rules of fscanf's %s, %d and %lf, so that a file is
+// split into records exactly like the former fscanf loop did (a malformed record consumes
+// its input up to the first failing field, the next record starts there)
+struct tLabelScanner {
+  const char *p, *end;
+  tLabelScanner (const char *data, size_t size) : p(data), end(data+size) {}
+
+  void skipSpace () { while (p < end && isspace((unsigned char)*p)) p++; }
+  bool atEnd () { skipSpace(); return p == end; }
+  bool isDigit (const char *q) const { return q < end && *q >= '0' && *q <= '9'; }
+
+  bool str (const char *&b, const char *&e) {
+    skipSpace();
+    b = p;
+    while (p < end && !isspace((unsigned char)*p)) p++;
+    e = p;
+    return b != e;
+  }
+
+  bool integer (int32_t &v) {
+    skipSpace();
+    bool neg = false;
+    if (p < end && (*p == '+' || *p == '-')) neg = *p++ == '-';
+    if (!isDigit(p))
+      return false;
+    const char *digits = p;
+    while (isDigit(p)) p++;
+    int64_t x = 0;
+    from_chars(digits, p, x);
+    v = (int32_t)(neg ? -x : x);
+    return true;
+  }
+
+  // consumes the longest prefix of keyword k (case insensitive), true if all of k matched
+  bool keyword (const char *k) {
+    for (; *k; k++, p++)
+      if (p == end || tolower((unsigned char)*p) != *k)
+        return false;
+    return true;
+  }
+
+  bool isHexDigit (const char *q) const { return q < end && isxdigit((unsigned char)*q); }
+
+  bool real (double &v) {
+    skipSpace();
+    bool neg = false;
+    if (p < end && (*p == '+' || *p == '-')) neg = *p++ == '-';
+    if (p < end && (*p == 'i' || *p == 'I')) {
+      if (!keyword("inf"))
+        return false;
+      if (p < end && (*p == 'i' || *p == 'I') && !keyword("inity"))
+        return false;
+      v = neg ? -INFINITY : INFINITY;
+      return true;
+    }
+    if (p < end && (*p == 'n' || *p == 'N')) {
+      if (!keyword("nan"))
+        return false;
+      v = neg ? -NAN : NAN;
+      return true;
+    }
+
+    // mantissa, the exponent marker is consumed even if no exponent digits follow
+    bool hex = end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X');
+    if (hex) p += 2;
+    const char *b = p;
+    bool mantissa = false;
+    while (hex ? isHexDigit(p) : isDigit(p)) { p++; mantissa = true; }
+    if (p < end && *p == '.') {
+      p++;
+      while (hex ? isHexDigit(p) : isDigit(p)) { p++; mantissa = true; }
+    }
+    if (!mantissa)
+      return false;
+    const char *e = p;
+    if (p < end && (hex ? (*p == 'p' || *p == 'P') : (*p == 'e' || *p == 'E'))) {
+      p++;
+      if (p < end && (*p == '+' || *p == '-')) p++;
+      if (isDigit(p)) {
+        while (isDigit(p)) p++;
+        e = p;
+      }
+    }
+    // values out of range fall back to strtod, which yields +-HUGE_VAL or a denormal like fscanf
+    if (from_chars(b, e, v, hex ? chars_format::hex : chars_format::general).ec != errc())
+      v = strtod(((hex ? "0x" : "") + string(b, e)).c_str(), NULL);
+    if (neg) v = -v;
+    return true;
+  }
+};
+
+// no. of lines of a mapped file, an upper bound for the no. of boxes
+size_t countLines(const tMappedFile &f) {
+  return f.size ? count(f.data, f.data + f.size, '\n') + 1 : 0;
+}
+
 vector<tDetection> loadDetection(string file_name) {
 
   vector<tDetection> detections;
-  FILE *fp = fopen(file_name.c_str(),"r");
-  if (!fp)
-    throw invalid_argument("cannot read detection file " + file_name);
-  while (!feof(fp)) {
+  tMappedFile f(file_name, "detection");
+  detections.reserve(countLines(f));
+  tLabelScanner s(f.data, f.size);
+  while (!s.atEnd()) {
     tDetection d;
-    int trash;
-    char str[255];
-    if (fscanf(fp, "%s %d %d %d %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf",
-                   str, &trash, &trash, &trash, &d.box.alpha, &d.box.x1, &d.box.y1,
-                   //&d.box.x2, &d.box.y2, &d.h, &d.w, &d.l, &d.t1, &d.t2, &d.t3, //old
-                   &d.box.x2, &d.box.y2, &d.l, &d.h, &d.w, &d.t1, &d.t2, &d.t3, //new
-                   &d.ry, &d.thresh)==17) {
-      d.box.type = str;
+    int32_t trash;
+    const char *b, *e;
+    // %s %d %d %d %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf
+    if (s.str(b, e) && s.integer(trash) && s.integer(trash) && s.integer(trash) &&
+        s.real(d.box.alpha) && s.real(d.box.x1) && s.real(d.box.y1) &&
+        s.real(d.box.x2) && s.real(d.box.y2) && s.real(d.l) && s.real(d.h) && s.real(d.w) &&
+        s.real(d.t1) && s.real(d.t2) && s.real(d.t3) && s.real(d.ry) && s.real(d.thresh)) {
+      d.box.type = internClass(b, e);
       detections.push_back(d);
     }
   }
-
-  fclose(fp);
   return detections;
 }
 
 vector<tGroundtruth> loadGroundtruth(string file_name) {
   vector<tGroundtruth> groundtruth;
-  FILE *fp = fopen(file_name.c_str(),"r");
-  if (!fp)
-    throw invalid_argument("cannot read ground truth file " + file_name);
-  while (!feof(fp)) {
+  tMappedFile f(file_name, "ground truth");
+  groundtruth.reserve(countLines(f));
+  tLabelScanner s(f.data, f.size);
+  while (!s.atEnd()) {
     tGroundtruth g;
-    int trash;
-    char str[255];
-    if (fscanf(fp, "%s %d %d %d %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %d %d",
-                   str, &g.truncation, &g.occlusion, &g.num_points_3d,
-                   &g.box.alpha, &g.box.x1, &g.box.y1, &g.box.x2, &g.box.y2,
-                   //&g.h, &g.w, &g.l, &g.t1, &g.t2, &g.t3, &g.ry, &trash)==17) { // old
-                    &g.l, &g.h, &g.w, &g.t1, &g.t2, &g.t3, &g.ry, &trash)==17) { // new
-      g.box.type = str;
+    int32_t trash;
+    const char *b, *e;
+    // %s %d %d %d %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %d, a record is only kept if
+    // the %d that traditionally followed in the format does not match as well
+    if (s.str(b, e) && s.integer(g.truncation) && s.integer(g.occlusion) && s.integer(g.num_points_3d) &&
+        s.real(g.box.alpha) && s.real(g.box.x1) && s.real(g.box.y1) && s.real(g.box.x2) && s.real(g.box.y2) &&
+        s.real(g.l) && s.real(g.h) && s.real(g.w) && s.real(g.t1) && s.real(g.t2) && s.real(g.t3) &&
+        s.real(g.ry) && s.integer(trash) && !s.integer(trash)) {
+      g.box.type = internClass(b, e);
       groundtruth.push_back(g);
     }
   }
-  fclose(fp);
   return groundtruth;
 }
 
 
 vector<string> list_dir(const string path) {
+  tScopedTimer timer("list_dir", path);
   struct dirent *entry;
   DIR *dir = opendir(path.c_str());
   vector<string> entries;
@@ -196,16 +854,785 @@ vector<string> list_dir(const string path) {
       entries.push_back(entry->d_name);
   }
   closedir(dir);
+  // sorted, so that the frame order does not depend on the file system
+  sort(entries.begin(), entries.end());
   return entries;
 }
 
+/*=======================================================================
+BINARY LABEL CACHE
+=======================================================================*/
+
+// A label cache packs all label files of one directory tree into a single file:
+//   tCacheHeader | tCacheEntry[n_entries] | type names (offset, size)[n_types] | strings |
+//   int32 columns truncation, occlusion, num_points_3d, type [n_boxes] |
+//   double columns alpha, x1, y1, x2, y2, l, h, w, t1, t2, t3, ry, thresh [n_boxes]
+// Entries are the label files in load order, followed by the directories that were listed.
+// A cache is only used if the mtime and size of every entry are unchanged.
+const char     CACHE_MAGIC[8]    = {'J','R','D','B','L','B','L','S'};
+const uint32_t CACHE_VERSION     = 1;
+const int32_t  CACHE_INT_COLS    = 4;
+const int32_t  CACHE_DOUBLE_COLS = 13;
+
+struct tCacheHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t n_entries;
+  uint64_t n_boxes;
+  uint32_t n_types;
+  uint32_t strings_size;
+};
+
+struct tCacheEntry {
+  int64_t  mtime;       // modification time in ns
+  int64_t  size;        // file size, -1 for directories
+  uint64_t box_begin;   // boxes of this file are [box_begin, box_end)
+  uint64_t box_end;
+  uint32_t path_offset; // path relative to the cached root, in the string table
+  uint32_t path_size;
+};
+
+// pointers to the columns of a ground truth or detection (fields the type does not have point to a dummy)
+inline void cacheFields(tGroundtruth &g, int32_t *i[CACHE_INT_COLS-1], double *d[CACHE_DOUBLE_COLS], int32_t *, double *dummy) {
+  int32_t *ic[] = {&g.truncation, &g.occlusion, &g.num_points_3d};
+  double  *dc[] = {&g.box.alpha, &g.box.x1, &g.box.y1, &g.box.x2, &g.box.y2, &g.l, &g.h, &g.w, &g.t1, &g.t2, &g.t3, &g.ry, dummy};
+  copy(ic, ic+CACHE_INT_COLS-1, i);
+  copy(dc, dc+CACHE_DOUBLE_COLS, d);
+}
+
+inline void cacheFields(tDetection &det, int32_t *i[CACHE_INT_COLS-1], double *d[CACHE_DOUBLE_COLS], int32_t *int_dummy, double *) {
+  int32_t *ic[] = {int_dummy, int_dummy, int_dummy};
+  double  *dc[] = {&det.box.alpha, &det.box.x1, &det.box.y1, &det.box.x2, &det.box.y2, &det.l, &det.h, &det.w, &det.t1, &det.t2, &det.t3, &det.ry, &det.thresh};
+  copy(ic, ic+CACHE_INT_COLS-1, i);
+  copy(dc, dc+CACHE_DOUBLE_COLS, d);
+}
+
+// mtime in ns and size of a file (-1 for directories), false if it does not exist
+bool fileStamp(const string &path, int64_t &mtime, int64_t &size) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return false;
+  mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  size = S_ISDIR(st.st_mode) ? -1 : st.st_size;
+  return true;
+}
+
+inline size_t alignCache(size_t offset) { return (offset + 7) & ~(size_t)7; }
+
+// writes the label files files (relative to root, in load order) with their boxes and the listed
+// directories dirs to cache_path, a failure only costs the speedup of the next run
+template <typename T>
+void writeLabelCache(const string &cache_path, const string &root, const vector<string> &files,
+        const tFrameStore<T> &labels, const vector<string> &dirs) {
+
+  vector<string> paths(files);
+  paths.insert(paths.end(), dirs.begin(), dirs.end());
+
+  tCacheHeader h;
+  memset(&h, 0, sizeof(h));
+  copy(CACHE_MAGIC, CACHE_MAGIC+8, h.magic);
+  h.version = CACHE_VERSION;
+  h.n_entries = paths.size();
+
+  string strings;
+  map<tClassId, int32_t> type_ids;
+  vector<pair<uint32_t, uint32_t> > types;
+  vector<tCacheEntry> entries(paths.size());
+  for (size_t k = 0; k < paths.size(); k++) {
+    tCacheEntry &e = entries[k];
+    if (!fileStamp(root + '/' + paths[k], e.mtime, e.size))
+      return;
+    e.path_offset = strings.size();
+    e.path_size = paths[k].size();
+    strings += paths[k];
+    e.box_begin = h.n_boxes;
+    if (k < labels.size())
+      h.n_boxes += labels[k].size();
+    e.box_end = h.n_boxes;
+  }
+
+  vector<int32_t> ints(CACHE_INT_COLS * h.n_boxes);
+  vector<double> doubles(CACHE_DOUBLE_COLS * h.n_boxes);
+  size_t n = 0;
+  int32_t int_dummy;
+  double dummy;
+  for (size_t k = 0; k < labels.size(); k++) {
+    for (T box : labels[k]) {
+      int32_t *i[CACHE_INT_COLS-1];
+      double *d[CACHE_DOUBLE_COLS];
+      cacheFields(box, i, d, &int_dummy, &dummy);
+      for (int32_t c = 0; c < CACHE_INT_COLS-1; c++)
+        ints[c * h.n_boxes + n] = *i[c];
+      for (int32_t c = 0; c < CACHE_DOUBLE_COLS; c++)
+        doubles[c * h.n_boxes + n] = *d[c];
+      auto it = type_ids.find(box.box.type);
+      if (it == type_ids.end()) {
+        string name = className(box.box.type);
+        it = type_ids.insert(make_pair(box.box.type, (int32_t)types.size())).first;
+        types.push_back(make_pair((uint32_t)strings.size(), (uint32_t)name.size()));
+        strings += name;
+      }
+      ints[(CACHE_INT_COLS-1) * h.n_boxes + n] = it->second;
+      n++;
+    }
+  }
+  h.n_types = types.size();
+  h.strings_size = strings.size();
+
+  // written to a temporary file first, so a concurrent run never maps a partial cache
+  string tmp_path = cache_path + ".tmp" + to_string(getpid());
+  ofstream out(tmp_path, ios::binary);
+  if (!out)
+    return;
+  size_t offset = 0;
+  auto put = [&](const void *p, size_t size) { out.write((const char*)p, size); offset += size; };
+  auto pad = [&]() { static const char zeros[8] = {0}; put(zeros, alignCache(offset) - offset); };
+  put(&h, sizeof(h));
+  put(entries.data(), entries.size() * sizeof(tCacheEntry));
+  put(types.data(), types.size() * sizeof(types[0]));
+  put(strings.data(), strings.size());
+  pad();
+  put(ints.data(), ints.size() * sizeof(int32_t));
+  pad();
+  put(doubles.data(), doubles.size() * sizeof(double));
+  out.close();
+  if (!out || rename(tmp_path.c_str(), cache_path.c_str()) != 0) {
+    remove(tmp_path.c_str());
+    return;
+  }
+  cout << "Wrote label cache " << cache_path << endl;
+}
+
+// maps the cache at cache_path and unpacks its label files if none of them changed. If files is
+// not empty, the cache must hold exactly these files, otherwise files is set from the cache.
+template <typename T>
+bool readLabelCache(const string &cache_path, const string &root, vector<string> &files,
+        tFrameStore<T> &labels) {
+
+  int fd = open(cache_path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(tCacheHeader)) {
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return false;
+  const char *data = (const char*)p;
+  bool valid = false;
+
+  do {
+    tCacheHeader h;
+    memcpy(&h, data, sizeof(h));
+    if (!equal(CACHE_MAGIC, CACHE_MAGIC+8, h.magic) || h.version != CACHE_VERSION)
+      break;
+    // bounds the sizes below by the file size, so the layout check cannot overflow
+    if (h.n_boxes > size / sizeof(double) || h.strings_size > size)
+      break;
+    size_t entries_offset = sizeof(h);
+    size_t types_offset = entries_offset + (size_t)h.n_entries * sizeof(tCacheEntry);
+    size_t strings_offset = types_offset + (size_t)h.n_types * 2 * sizeof(uint32_t);
+    size_t ints_offset = alignCache(strings_offset + h.strings_size);
+    size_t doubles_offset = alignCache(ints_offset + CACHE_INT_COLS * h.n_boxes * sizeof(int32_t));
+    if (doubles_offset + CACHE_DOUBLE_COLS * h.n_boxes * sizeof(double) != size)
+      break;
+    const tCacheEntry *entries = (const tCacheEntry*)(data + entries_offset);
+    const uint32_t *types = (const uint32_t*)(data + types_offset);
+    const char *strings = data + strings_offset;
+    const int32_t *ints = (const int32_t*)(data + ints_offset);
+    const double *doubles = (const double*)(data + doubles_offset);
+
+    // every offset and id read from the file is checked before use, a corrupt cache is rebuilt
+    auto inStrings = [&](uint64_t offset, uint64_t n) { return offset <= h.strings_size && n <= h.strings_size - offset; };
+
+    // every cached file and directory must be unchanged
+    vector<string> paths(h.n_entries);
+    bool fresh = true;
+    for (uint32_t k = 0; k < h.n_entries && fresh; k++) {
+      const tCacheEntry &e = entries[k];
+      if (!inStrings(e.path_offset, e.path_size)) {
+        fresh = false;
+        break;
+      }
+      paths[k].assign(strings + e.path_offset, e.path_size);
+      int64_t mtime, fsize;
+      fresh = fileStamp(root + '/' + paths[k], mtime, fsize) && mtime == e.mtime && fsize == e.size;
+    }
+    if (!fresh)
+      break;
+    size_t n_files = 0;
+    while (n_files < h.n_entries && entries[n_files].size >= 0)
+      n_files++;
+    if (!files.empty() && !equal(files.begin(), files.end(), paths.begin(), paths.begin() + min(files.size(), n_files)))
+      break;
+    if (!files.empty() && files.size() != n_files)
+      break;
+
+    bool types_valid = true;
+    for (uint32_t t = 0; t < h.n_types && types_valid; t++)
+      types_valid = inStrings(types[2*t], types[2*t+1]);
+    if (!types_valid)
+      break;
+    // the boxes of the files follow each other, so they unpack straight into the arena
+    bool contiguous = true;
+    for (size_t k = 0; k < n_files && contiguous; k++)
+      contiguous = entries[k].box_begin == (k ? entries[k-1].box_end : 0) &&
+                   entries[k].box_begin <= entries[k].box_end && entries[k].box_end <= h.n_boxes;
+    if (!contiguous)
+      break;
+    const int32_t *box_types = ints + (CACHE_INT_COLS-1) * h.n_boxes;
+    uint64_t n_boxes = n_files ? entries[n_files-1].box_end : 0;
+    bool ids_valid = true;
+    for (uint64_t b = 0; b < n_boxes && ids_valid; b++)
+      ids_valid = box_types[b] >= 0 && (uint32_t)box_types[b] < h.n_types;
+    if (!ids_valid)
+      break;
+
+    vector<tClassId> type_ids(h.n_types);
+    for (uint32_t t = 0; t < h.n_types; t++)
+      type_ids[t] = internClass(strings + types[2*t], strings + types[2*t] + types[2*t+1]);
+    files.assign(paths.begin(), paths.begin() + n_files);
+    labels.clear();
+    labels.boxes.resize(n_boxes);
+    int32_t int_dummy;
+    double dummy;
+    for (size_t k = 0; k < n_files; k++) {
+      const tCacheEntry &e = entries[k];
+      labels.offset.push_back(e.box_end);
+      for (uint64_t b = e.box_begin; b < e.box_end; b++) {
+        T &box = labels.boxes[b];
+        int32_t *i[CACHE_INT_COLS-1];
+        double *d[CACHE_DOUBLE_COLS];
+        cacheFields(box, i, d, &int_dummy, &dummy);
+        for (int32_t c = 0; c < CACHE_INT_COLS-1; c++)
+          *i[c] = ints[c * h.n_boxes + b];
+        for (int32_t c = 0; c < CACHE_DOUBLE_COLS; c++)
+          *d[c] = doubles[c * h.n_boxes + b];
+        box.box.type = type_ids[box_types[b]];
+      }
+    }
+    valid = true;
+  } while (false);
+
+  munmap(p, size);
+  return valid;
+}
+
+// cache file of a label directory, placed next to it
+string cachePath(string dir, const string &suffix) {
+  while (dir.size() > 1 && dir.back() == '/')
+    dir.pop_back();
+  return dir + suffix;
+}
+
+// frames parsed at once by loadLabelFiles, only their boxes are held outside of the arena
+const size_t FRAMES_PER_LOAD_BLOCK = 1024;
+
+// loads the label files (relative to root) into store on n_threads threads. Every file is mapped
+// once, the files are parsed in blocks that are moved into the arena, so the labels are held about
+// once while loading as well. The arena is reserved from the boxes per frame of the blocks parsed
+// so far, extrapolated to all files, and only grows again if a later block exceeds the estimate.
+template <typename T>
+void loadLabelFiles(const string &root, const vector<string> &files, vector<T> (*load)(string),
+        int32_t n_threads, tFrameStore<T> &store) {
+
+  store.clear();
+  store.offset.reserve(files.size() + 1);
+
+  vector<vector<T> > block;
+  for (size_t begin = 0; begin < files.size(); begin += FRAMES_PER_LOAD_BLOCK) {
+    size_t end = min(files.size(), begin + FRAMES_PER_LOAD_BLOCK);
+    block.assign(end - begin, vector<T>());
+    parallelFor(end - begin, n_threads, [&](size_t i) {
+      block[i] = load(root + '/' + files[begin + i]);
+    });
+    size_t n_boxes = store.boxes.size();
+    for (const auto &frame : block)
+      n_boxes += frame.size();
+    if (n_boxes > store.boxes.capacity())
+      store.boxes.reserve(max(n_boxes, (size_t)ceil((double)n_boxes / end * files.size())));
+    for (auto &frame : block)
+      store.append(frame);
+  }
+}
+
+/*=======================================================================
+JRDB JSON LABELS
+=======================================================================*/
+
+// pull parser over JSON text: values are read or skipped in document order, so a label file is
+// parsed in a single pass without building a document tree. Objects are read as
+// "expect('{'); while (nextMember(key)) ...;" and arrays as "expect('['); while (nextElement()) ...;".
+struct tJsonReader {
+  const char *begin, *p, *end;
+  string      file_name;
+  tJsonReader (const char *data, size_t size, const string &file_name) :
+    begin(data), p(data), end(data+size), file_name(file_name) {}
+
+  [[noreturn]] void fail (const string &msg) {
+    throw invalid_argument("malformed JSON in " + file_name + " at byte " + to_string(p - begin) + ": " + msg);
+  }
+  char peek () {
+    while (p < end && isspace((unsigned char)*p)) p++;
+    return p < end ? *p : 0;
+  }
+  void expect (char c) {
+    if (peek() != c)
+      fail(string("expected '") + c + "'");
+    p++;
+  }
+
+  // next member of the current object, false after its closing brace
+  bool nextMember (string &key) {
+    if (peek() == ',')
+      p++;
+    if (peek() == '}') {
+      p++;
+      return false;
+    }
+    str(key);
+    expect(':');
+    return true;
+  }
+
+  // true if the current array has another element, false after its closing bracket
+  bool nextElement () {
+    if (peek() == ',')
+      p++;
+    if (peek() == ']') {
+      p++;
+      return false;
+    }
+    return true;
+  }
+
+  void str (string &s) {
+    expect('"');
+    s.clear();
+    while (p < end && *p != '"') {
+      if (*p != '\\') {
+        s += *p++;
+        continue;
+      }
+      if (++p == end)
+        break;
+      char c = *p++;
+      switch (c) {
+        case 'b': s += '\b'; break;
+        case 'f': s += '\f'; break;
+        case 'n': s += '\n'; break;
+        case 'r': s += '\r'; break;
+        case 't': s += '\t'; break;
+        case 'u': {
+          // code points of the basic plane only, as UTF-8
+          unsigned cp = 0;
+          if (end - p < 4 || from_chars(p, p + 4, cp, 16).ptr != p + 4)
+            fail("bad \\u escape");
+          p += 4;
+          if (cp < 0x80) {
+            s += (char)cp;
+          } else if (cp < 0x800) {
+            s += (char)(0xc0 | cp >> 6);
+            s += (char)(0x80 | (cp & 0x3f));
+          } else {
+            s += (char)(0xe0 | cp >> 12);
+            s += (char)(0x80 | (cp >> 6 & 0x3f));
+            s += (char)(0x80 | (cp & 0x3f));
+          }
+          break;
+        }
+        default: s += c;
+      }
+    }
+    expect('"');
+  }
+
+  double number () {
+    peek();
+    double v = 0;
+    auto r = from_chars(p, end, v);
+    if (r.ec != errc())
+      fail("expected a number");
+    p = r.ptr;
+    return v;
+  }
+
+  bool literal (const char *word) {
+    size_t n = strlen(word);
+    if ((size_t)(end - p) < n || strncmp(p, word, n) != 0)
+      return false;
+    p += n;
+    return true;
+  }
+
+  // a boolean, or a string that reads "true" (case insensitive) as in the conversion scripts
+  bool boolean () {
+    char c = peek();
+    if (c == '"') {
+      string s;
+      str(s);
+      return !strcasecmp(s.c_str(), "true");
+    }
+    if (literal("true"))
+      return true;
+    if (!literal("false"))
+      fail("expected a boolean");
+    return false;
+  }
+
+  void skipValue () {
+    string s;
+    switch (peek()) {
+      case '{':
+        p++;
+        while (nextMember(s))
+          skipValue();
+        break;
+      case '[':
+        p++;
+        while (nextElement())
+          skipValue();
+        break;
+      case '"':
+        str(s);
+        break;
+      case 't': case 'f': case 'n':
+        if (!literal("true") && !literal("false") && !literal("null"))
+          fail("unexpected literal");
+        break;
+      default:
+        number();
+    }
+  }
+};
+
+// one annotation or detection of a JRDB label file, fields that are not given keep -1
+struct tJsonLabel {
+  string  label_id;
+  bool    has_2d, has_3d;
+  double  box_2d[4];        // x, y, width, height
+  double  cx, cy, cz, l, w, h, rot_z;
+  double  alpha;            // observation_angle
+  int32_t num_points;
+  int32_t truncated, occlusion;
+  double  score;
+  tJsonLabel () : has_2d(false), has_3d(false), cx(-1), cy(-1), cz(-1), l(-1), w(-1), h(-1), rot_z(-1),
+    alpha(-1), num_points(-1), truncated(-1), occlusion(-1), score(-1) {
+    fill(box_2d, box_2d+4, -1);
+  }
+};
+
+const char *JRDB_OCCLUSION[] = {"Fully_visible", "Mostly_visible", "Severely_occluded", "Fully_occluded"};
+
+// reads the labels of all frames of a per-sequence JRDB file ({"labels" or "detections":
+// {"<frame>.<ext>": [label, ...]}}) into frames, keyed by the frame name without extension
+void loadJsonLabels(const string &file_name, map<string, vector<tJsonLabel> > &frames) {
+  tMappedFile f(file_name, "label");
+  tJsonReader r(f.data, f.size, file_name);
+  string key, frame, attribute;
+  r.expect('{');
+  while (r.nextMember(key)) {
+    if (key != "labels" && key != "detections") {
+      r.skipValue();
+      continue;
+    }
+    r.expect('{');
+    while (r.nextMember(frame)) {
+      vector<tJsonLabel> &labels = frames[frame.substr(0, frame.rfind('.'))];
+      r.expect('[');
+      while (r.nextElement()) {
+        tJsonLabel label;
+        r.expect('{');
+        while (r.nextMember(key)) {
+          if (key == "label_id") {
+            r.str(label.label_id);
+          } else if (key == "score") {
+            label.score = r.number();
+          } else if (key == "observation_angle") {
+            label.alpha = r.number();
+          } else if (key == "box" && r.peek() == '[') {
+            // 2D box x, y, width, height
+            r.expect('[');
+            for (int32_t k = 0; r.nextElement(); k++) {
+              if (k >= 4)
+                r.fail("2D box with more than 4 values");
+              label.box_2d[k] = r.number();
+            }
+            label.has_2d = true;
+          } else if (key == "box") {
+            r.expect('{');
+            while (r.nextMember(attribute)) {
+              double *v = attribute == "cx" ? &label.cx : attribute == "cy" ? &label.cy : attribute == "cz" ? &label.cz :
+                          attribute == "l" ? &label.l : attribute == "w" ? &label.w : attribute == "h" ? &label.h :
+                          attribute == "rot_z" ? &label.rot_z : NULL;
+              if (v)
+                *v = r.number();
+              else
+                r.skipValue();
+            }
+            label.has_3d = true;
+          } else if (key == "attributes") {
+            r.expect('{');
+            while (r.nextMember(attribute)) {
+              if (attribute == "num_points") {
+                label.num_points = (int32_t)r.number();
+              } else if (attribute == "truncated") {
+                label.truncated = r.boolean();
+              } else if (attribute == "occlusion" && r.peek() == '"') {
+                string occlusion;
+                r.str(occlusion);
+                auto it = find(JRDB_OCCLUSION, JRDB_OCCLUSION+4, occlusion);
+                if (it == JRDB_OCCLUSION+4)
+                  r.fail("unknown occlusion " + occlusion);
+                label.occlusion = it - JRDB_OCCLUSION;
+              } else if (attribute == "occlusion") {
+                label.occlusion = (int32_t)r.number();
+              } else {
+                r.skipValue();
+              }
+            }
+          } else {
+            r.skipValue();
+          }
+        }
+        labels.push_back(label);
+      }
+    }
+  }
+}
+
+// KITTI camera coordinates of a JRDB lidar box as written by convert_labels_to_KITTI.py, whose
+// label lines list h, l, w where the label files hold l, h, w
+template <typename T>
+void jsonBox3D(const tJsonLabel &label, T &box) {
+  box.ry = label.rot_z < M_PI ? -label.rot_z : 2 * M_PI - label.rot_z;
+  box.l = label.h;
+  box.h = label.l;
+  box.w = label.w;
+  box.t1 = -label.cy;
+  box.t2 = -label.cz + label.h / 2;
+  box.t3 = label.cx;
+}
+
+// ground truth of the pedestrian label_id, joined from its 2D and 3D labels (either may be NULL)
+tGroundtruth jsonGroundtruth(const tJsonLabel *label_2d, const tJsonLabel *label_3d) {
+  tJsonLabel none;
+  const tJsonLabel &l2 = label_2d ? *label_2d : none, &l3 = label_3d ? *label_3d : none;
+  tGroundtruth g(tBox(PEDESTRIAN, -1, -1, -1, -1, l3.alpha), l2.truncated, l2.occlusion);
+  if (label_2d) {
+    g.box.x1 = l2.box_2d[0];
+    g.box.y1 = l2.box_2d[1];
+    g.box.x2 = l2.box_2d[0] + l2.box_2d[2];
+    g.box.y2 = l2.box_2d[1] + l2.box_2d[3];
+  }
+  g.num_points_3d = l3.num_points;
+  if (label_3d)
+    jsonBox3D(l3, g);
+  else
+    g.ry = g.l = g.h = g.w = g.t1 = g.t2 = g.t3 = -1;
+  return g;
+}
+
+// pedestrian detection, from a 2D box (x, y, width, height) or a 3D box in lidar coordinates
+tDetection jsonDetection(const tJsonLabel &label) {
+  tDetection d(tBox(PEDESTRIAN, -1, -1, -1, -1, label.alpha), label.score);
+  if (label.has_2d) {
+    d.box.x1 = label.box_2d[0];
+    d.box.y1 = label.box_2d[1];
+    d.box.x2 = label.box_2d[0] + label.box_2d[2];
+    d.box.y2 = label.box_2d[1] + label.box_2d[3];
+  }
+  jsonBox3D(label, d);
+  if (!label.has_3d)
+    d.ry = d.l = d.h = d.w = d.t1 = d.t2 = d.t3 = -1;
+  return d;
+}
+
+// only pedestrians are evaluated, as by the conversion scripts (detections without an id are kept)
+inline bool jsonPedestrian(const string &label_id) {
+  return label_id.empty() || !label_id.compare(0, 11, "pedestrian:") || !label_id.compare(0, 7, "person:");
+}
+
+// per-sequence JSON files of a directory (sequence names without extension)
+vector<string> jsonSequences(const string &dir) {
+  vector<string> sequences;
+  for (const auto &file : list_dir(dir))
+    if (file.size() > 5 && !file.compare(file.size() - 5, 5, ".json"))
+      sequences.push_back(file.substr(0, file.size() - 5));
+  return sequences;
+}
+
+// loads the ground truth of the JRDB label directory labels_dir (labels_2d_stitched/<sequence>.json
+// and labels_3d/<sequence>.json) without converting it to label files first. The 2D and 3D labels
+// of a frame are joined by label_id like convert_labels_to_KITTI.py does, in the order of the 2D
+// labels followed by the labels with a 3D box only. Frames are named <frame>.txt like the files of
+// a converted tree.
+void loadGroundtruthJson(const string &labels_dir, const tEvalOptions &options,
+        tGroundtruthStore &groundtruths, vector<pair<string, string> > &frames) {
+
+  vector<string> sequences = jsonSequences(labels_dir + "/labels_3d");
+  if (jsonSequences(labels_dir + "/labels_2d_stitched") != sequences)
+    throw invalid_argument("2D and 3D label sequences of " + labels_dir + " do not match");
+
+  vector<map<string, vector<tGroundtruth> > > sequence_frames(sequences.size());
+  parallelFor(sequences.size(), options.n_threads, [&](size_t s) {
+    map<string, vector<tJsonLabel> > labels_2d, labels_3d;
+    loadJsonLabels(labels_dir + "/labels_2d_stitched/" + sequences[s] + ".json", labels_2d);
+    loadJsonLabels(labels_dir + "/labels_3d/" + sequences[s] + ".json", labels_3d);
+    if (labels_2d.size() != labels_3d.size() ||
+        !equal(labels_2d.begin(), labels_2d.end(), labels_3d.begin(),
+               [](const auto &a, const auto &b) { return a.first == b.first; }))
+      throw invalid_argument("2D and 3D frames of sequence " + sequences[s] + " do not match");
+
+    for (const auto &frame : labels_2d) {
+      const vector<tJsonLabel> &frame_3d = labels_3d[frame.first];
+      vector<tGroundtruth> &gt = sequence_frames[s][frame.first + ".txt"];
+      // the last label of an id wins, as in the dictionaries of the conversion script
+      map<string, const tJsonLabel*> by_id_2d, by_id_3d;
+      for (const tJsonLabel &label : frame.second)
+        by_id_2d[label.label_id] = &label;
+      for (const tJsonLabel &label : frame_3d)
+        by_id_3d[label.label_id] = &label;
+      set<string> joined;
+      for (const tJsonLabel &label : frame.second) {
+        if (!label.label_id.compare(0, 11, "pedestrian:") && joined.insert(label.label_id).second) {
+          auto it = by_id_3d.find(label.label_id);
+          gt.push_back(jsonGroundtruth(by_id_2d[label.label_id], it == by_id_3d.end() ? NULL : it->second));
+        }
+      }
+      for (const tJsonLabel &label : frame_3d)
+        if (!label.label_id.compare(0, 11, "pedestrian:") && joined.insert(label.label_id).second)
+          gt.push_back(jsonGroundtruth(NULL, by_id_3d[label.label_id]));
+    }
+  });
+
+  groundtruths.clear();
+  frames.clear();
+  for (size_t s = 0; s < sequences.size(); s++) {
+    for (auto &frame : sequence_frames[s]) {
+      frames.push_back(make_pair(sequences[s], frame.first));
+      groundtruths.append(frame.second);
+    }
+  }
+}
+
+// loads the predictions of the ground truth frames from the per-sequence JSON files
+// result_dir/<sequence>.json, frames without an entry have no detections
+void loadPredictionsJson(const string &result_dir, const tEvalOptions &options,
+        const vector<pair<string, string> > &frames, tDetectionStore &detections) {
+
+  vector<string> sequences;
+  for (const auto &frame : frames)
+    if (sequences.empty() || sequences.back() != frame.first)
+      sequences.push_back(frame.first);
+
+  vector<map<string, vector<tJsonLabel> > > labels(sequences.size());
+  parallelFor(sequences.size(), options.n_threads, [&](size_t s) {
+    loadJsonLabels(result_dir + '/' + sequences[s] + ".json", labels[s]);
+  });
+
+  detections.clear();
+  size_t s = 0;
+  vector<tDetection> frame_det;
+  for (const auto &frame : frames) {
+    while (sequences[s] != frame.first)
+      s++;
+    frame_det.clear();
+    auto it = labels[s].find(frame.second.substr(0, frame.second.rfind('.')));
+    if (it != labels[s].end())
+      for (const tJsonLabel &label : it->second)
+        if (jsonPedestrian(label.label_id))
+          frame_det.push_back(jsonDetection(label));
+    detections.append(frame_det);
+  }
+}
+
+/*=======================================================================
+LOAD DATA
+=======================================================================*/
+
+// loads all frames of the ground truth tree gt_dir (sequence/frame, sorted by name) on
+// options.n_threads threads, frames holds the (sequence, frame) names in load order. With
+// options.use_cache, the tree is read from or packed into a label cache next to the directory.
+void loadGroundtruthTree(string gt_dir, const tEvalOptions &options,
+        tGroundtruthStore &groundtruths, vector<pair<string, string> > &frames) {
+
+  tScopedTimer timer("load ground truth");
+  auto start = chrono::steady_clock::now();
+  if (options.json) {
+    loadGroundtruthJson(gt_dir, options, groundtruths, frames);
+    cout << "Loaded JSON ground truth in " << secondsSince(start) << " s" << endl;
+    return;
+  }
+
+  string gt_cache = cachePath(gt_dir, ".gt.cache");
+
+  vector<string> gt_files;
+  if (!options.use_cache || !readLabelCache(gt_cache, gt_dir, gt_files, groundtruths)) {
+    gt_files.clear();
+    vector<string> dirs(1, ".");
+    vector<string> sequences = list_dir(gt_dir);
+    for (const auto& sequence : sequences) {
+      dirs.push_back(sequence);
+      for (const auto& frame : list_dir(gt_dir + '/' + sequence))
+        gt_files.push_back(sequence + '/' + frame);
+    }
+    cout << "Listed " << gt_files.size() << " ground truth files in " << secondsSince(start) << " s" << endl;
+    start = chrono::steady_clock::now();
+
+    loadLabelFiles(gt_dir, gt_files, loadGroundtruth, options.n_threads, groundtruths);
+    if (options.use_cache)
+      writeLabelCache(gt_cache, gt_dir, gt_files, groundtruths, dirs);
+  }
+  cout << "Loaded ground truth in " << secondsSince(start) << " s" << endl;
+
+  frames.clear();
+  for (const auto& file : gt_files) {
+    size_t slash = file.find('/');
+    frames.push_back(make_pair(file.substr(0, slash), file.substr(slash + 1)));
+  }
+}
+
+// loads the prediction files of the ground truth frames from result_dir on options.n_threads
+// threads. With options.use_cache, the tree is read from or packed into a label cache next to
+// the directory.
+void loadPredictions(string result_dir, bool depth, const tEvalOptions &options,
+        const vector<pair<string, string> > &frames, tDetectionStore &detections) {
+
+  tScopedTimer timer("load predictions");
+  auto start = chrono::steady_clock::now();
+  if (options.json) {
+    loadPredictionsJson(result_dir, options, frames, detections);
+    cout << "Loaded JSON predictions in " << secondsSince(start) << " s" << endl;
+    return;
+  }
+
+  string result_cache = cachePath(result_dir, depth ? ".det3d.cache" : ".det2d.cache");
+
+  vector<string> result_files;
+  for (const auto& frame : frames)
+    result_files.push_back(frame.first + (depth ? "/" : "/image_stitched/") + frame.second);
+
+  vector<string> requested(result_files);
+  if (!options.use_cache || requested.empty() || !readLabelCache(result_cache, result_dir, result_files, detections)) {
+    loadLabelFiles(result_dir, requested, loadDetection, options.n_threads, detections);
+    if (options.use_cache)
+      writeLabelCache(result_cache, result_dir, requested, detections, vector<string>());
+  }
+  cout << "Loaded predictions in " << secondsSince(start) << " s" << endl;
+}
+
 /*=======================================================================
 EVALUATION HELPER FUNCTIONS
 =======================================================================*/
 
 // criterion defines whether the overlap is computed with respect to both areas (ground truth and detection)
 // or with respect to box a or b (detection and "dontcare" areas)
-inline double imageBoxOverlap(tBox a, tBox b, int32_t criterion=-1){
+inline double imageBoxOverlap(const tBox &a, const tBox &b, int32_t criterion=-1){
 
   // overlap is invalid in the beginning
   double o = -1;
@@ -241,38 +1668,105 @@ inline double imageBoxOverlap(tBox a, tBox b, int32_t criterion=-1){
   return o;
 }
 
-inline double imageBoxOverlap(tDetection a, tGroundtruth b, int32_t criterion=-1){
+inline double imageBoxOverlap(const tDetection &a, const tGroundtruth &b, int32_t criterion=-1){
   return imageBoxOverlap(a.box, b.box, criterion);
 }
 
+// compute the ground plane corners (x=t1, y=t3) of an oriented bounding box
+template <typename T>
+inline void toCorners(const T& g, double corners[4][2]) {
+    double c = cos(g.ry), s = sin(g.ry);
+    double dx[4] = {g.l / 2, g.l / 2, -g.l / 2, -g.l / 2};
+    double dy[4] = {g.w / 2, -g.w / 2, -g.w / 2, g.w / 2};
+    for (int i = 0; i < 4; ++i) {
+        corners[i][0] = c * dx[i] + s * dy[i] + g.t1;
+        corners[i][1] = -s * dx[i] + c * dy[i] + g.t3;
+    }
+}
+
 // compute polygon of an oriented bounding box
 template <typename T>
 Polygon toPolygon(const T& g) {
-    using namespace boost::numeric::ublas;
     using namespace boost::geometry;
-    matrix<double> mref(2, 2);
-    mref(0, 0) = cos(g.ry); mref(0, 1) = sin(g.ry);
-    mref(1, 0) = -sin(g.ry); mref(1, 1) = cos(g.ry);
-
-    static int count = 0;
-    matrix<double> corners(2, 4);
-    double data[] = {g.l / 2, g.l / 2, -g.l / 2, -g.l / 2,
-                     g.w / 2, -g.w / 2, -g.w / 2, g.w / 2};
-    std::copy(data, data + 8, corners.data().begin());
-    matrix<double> gc = prod(mref, corners);
-    for (int i = 0; i < 4; ++i) {
-        gc(0, i) += g.t1;
-        gc(1, i) += g.t3;
-    }
+    double gc[4][2];
+    toCorners(g, gc);
 
-    double points[][2] = {{gc(0, 0), gc(1, 0)},{gc(0, 1), gc(1, 1)},{gc(0, 2), gc(1, 2)},{gc(0, 3), gc(1, 3)},{gc(0, 0), gc(1, 0)}};
+    double points[][2] = {{gc[0][0], gc[0][1]},{gc[1][0], gc[1][1]},{gc[2][0], gc[2][1]},{gc[3][0], gc[3][1]},{gc[0][0], gc[0][1]}};
     Polygon poly;
     append(poly, points);
     return poly;
 }
 
-// measure overlap between bird's eye view bounding boxes, parametrized by (ry, l, w, tx, tz)
-inline double groundBoxOverlap(tDetection d, tGroundtruth g, int32_t criterion = -1) {
+// signed area of a polygon given by its n vertices (shoelace formula)
+inline double polygonArea(const double p[][2], int n) {
+    double a = 0;
+    for (int i = 0, k = n - 1; i < n; k = i++)
+        a += p[k][0] * p[i][1] - p[i][0] * p[k][1];
+    return a / 2;
+}
+
+// intersection area of two convex quadrilaterals by Sutherland-Hodgman clipping of a against
+// the edges of b; clipping a 4-gon by 4 half planes yields at most 8 vertices, so no allocation
+inline double quadIntersectionArea(const double a[4][2], const double b[4][2]) {
+    double buf[2][8][2];
+    int n = 4;
+    for (int i = 0; i < 4; ++i) {
+        buf[0][i][0] = a[i][0];
+        buf[0][i][1] = a[i][1];
+    }
+    double orientation = polygonArea(b, 4) < 0 ? -1 : 1;
+    int cur = 0;
+    for (int e = 0; e < 4 && n > 0; ++e) {
+        const double *p = b[e], *q = b[(e + 1) % 4];
+        double ex = q[0] - p[0], ey = q[1] - p[1];
+        const double (*in)[2] = buf[cur];
+        double (*out)[2] = buf[1 - cur];
+        int m = 0;
+        for (int i = 0; i < n; ++i) {
+            const double *s = in[(i + n - 1) % n], *t = in[i];
+            double fs = orientation * (ex * (s[1] - p[1]) - ey * (s[0] - p[0]));
+            double ft = orientation * (ex * (t[1] - p[1]) - ey * (t[0] - p[0]));
+            if ((fs >= 0) != (ft >= 0)) {
+                double r = fs / (fs - ft);
+                out[m][0] = s[0] + (t[0] - s[0]) * r;
+                out[m][1] = s[1] + (t[1] - s[1]) * r;
+                ++m;
+            }
+            if (ft >= 0) {
+                out[m][0] = t[0];
+                out[m][1] = t[1];
+                ++m;
+            }
+        }
+        n = m;
+        cur = 1 - cur;
+    }
+    return n < 3 ? 0 : fabs(polygonArea(buf[cur], n));
+}
+
+// overlap of two oriented boxes on the ground plane (and in height for 3D) from the intersection area
+template <bool box3d>
+inline double rotatedBoxOverlap(const tDetection &d, const tGroundtruth &g, double inter_area, int32_t criterion) {
+    double d_size = d.l * d.w, g_size = g.l * g.w, inter = inter_area;
+    if (box3d) {
+        double ymax = min(d.t2, g.t2);
+        double ymin = max(d.t2 - d.h, g.t2 - g.h);
+        inter *= max(0.0, ymax - ymin);
+        d_size *= d.h;
+        g_size *= g.h;
+    }
+    double o = -1;
+    if(criterion==-1)     // union
+        o = inter / (d_size + g_size - inter);
+    else if(criterion==0) // bbox_a
+        o = inter / d_size;
+    else if(criterion==1) // bbox_b
+        o = inter / g_size;
+    return o;
+}
+
+// reference implementations based on boost::geometry
+inline double groundBoxOverlapBoost(const tDetection &d, const tGroundtruth &g, int32_t criterion = -1) {
     using namespace boost::geometry;
     Polygon gp = toPolygon(g);
     Polygon dp = toPolygon(d);
@@ -294,8 +1788,7 @@ inline double groundBoxOverlap(tDetection d, tGroundtruth g, int32_t criterion =
     return o;
 }
 
-// measure overlap between 3D bounding boxes, parametrized by (ry, h, w, l, tx, ty, tz)
-inline double box3DOverlap(tDetection d, tGroundtruth g, int32_t criterion = -1) {
+inline double box3DOverlapBoost(const tDetection &d, const tGroundtruth &g, int32_t criterion = -1) {
     using namespace boost::geometry;
     Polygon gp = toPolygon(g);
     Polygon dp = toPolygon(d);
@@ -324,15 +1817,180 @@ inline double box3DOverlap(tDetection d, tGroundtruth g, int32_t criterion = -1)
     return o;
 }
 
-vector<double> getThresholds(vector<double> &v, double n_groundtruth){
+// measure overlap between bird's eye view bounding boxes, parametrized by (ry, l, w, tx, tz)
+// (compile with -DUSE_BOOST_OVERLAP to evaluate with the boost::geometry reference)
+inline double groundBoxOverlap(const tDetection &d, const tGroundtruth &g, int32_t criterion = -1) {
+#ifdef USE_BOOST_OVERLAP
+    return groundBoxOverlapBoost(d, g, criterion);
+#else
+    double dc[4][2], gc[4][2];
+    toCorners(d, dc);
+    toCorners(g, gc);
+    return rotatedBoxOverlap<false>(d, g, quadIntersectionArea(gc, dc), criterion);
+#endif
+}
+
+// measure overlap between 3D bounding boxes, parametrized by (ry, h, w, l, tx, ty, tz)
+inline double box3DOverlap(const tDetection &d, const tGroundtruth &g, int32_t criterion = -1) {
+#ifdef USE_BOOST_OVERLAP
+    return box3DOverlapBoost(d, g, criterion);
+#else
+    double dc[4][2], gc[4][2];
+    toCorners(d, dc);
+    toCorners(g, gc);
+    return rotatedBoxOverlap<true>(d, g, quadIntersectionArea(gc, dc), criterion);
+#endif
+}
+
+// nuScenes-style matching on the distance of the ground plane centers (t1, t3), as an overlap that
+// exceeds MIN_OVERLAP[CENTER][level] iff the distance is below CENTER_DIST[level]. The criterion
+// does not matter, a dontcare area absorbs the detections near its center.
+inline double centerOverlap(const tDetection &d, const tGroundtruth &g, int32_t /*criterion*/ = -1) {
+    return 1 - sqrt((d.t1-g.t1)*(d.t1-g.t1) + (d.t3-g.t3)*(d.t3-g.t3)) / CENTER_MAX_DIST;
+}
+
+// the fields of the detections of one frame that the overlap kernels read, one array per field.
+// Corners and bounding circles are computed once per detection instead of once per pair.
+struct tBoxColumns {
+  vector<double> t1, t3, radius;         // ground plane center and bounding circle
+  vector<double> corners;                // ground plane corners (toCorners), 8 values per box
+  vector<double> lo_x, hi_x, lo_y, hi_y; // axis aligned bounds for the metric (see boxBounds)
+
+  tBoxColumns (tSpan<tDetection> det, METRIC metric) :
+    t1(det.size()), t3(det.size()), radius(det.size()), corners(8 * det.size()),
+    lo_x(det.size()), hi_x(det.size()), lo_y(det.size()), hi_y(det.size()) {
+    for (size_t j = 0; j < det.size(); j++) {
+      const tDetection &d = det[j];
+      t1[j] = d.t1;
+      t3[j] = d.t3;
+      radius[j] = 0.5 * sqrt(d.l * d.l + d.w * d.w);
+      double (*c)[2] = (double (*)[2])&corners[8 * j];
+      toCorners(d, c);
+      if (metric == IMAGE) {
+        lo_x[j] = min(d.box.x1, d.box.x2); hi_x[j] = max(d.box.x1, d.box.x2);
+        lo_y[j] = min(d.box.y1, d.box.y2); hi_y[j] = max(d.box.y1, d.box.y2);
+        continue;
+      }
+      if (metric == CENTER) {
+        lo_x[j] = d.t1 - CENTER_MAX_DIST/2; hi_x[j] = d.t1 + CENTER_MAX_DIST/2;
+        lo_y[j] = d.t3 - CENTER_MAX_DIST/2; hi_y[j] = d.t3 + CENTER_MAX_DIST/2;
+        continue;
+      }
+      lo_x[j] = hi_x[j] = c[0][0];
+      lo_y[j] = hi_y[j] = c[0][1];
+      for (int32_t k = 1; k < 4; k++) {
+        lo_x[j] = min(lo_x[j], c[k][0]); hi_x[j] = max(hi_x[j], c[k][0]);
+        lo_y[j] = min(lo_y[j], c[k][1]); hi_y[j] = max(hi_y[j], c[k][1]);
+      }
+    }
+  }
+};
+
+// overlap of a detection with a ground truth box for one metric as a functor, so the matching
+// loops that are specialized on it inline the overlap computation
+template <METRIC metric> struct tBoxOverlap;
+
+template <> struct tBoxOverlap<IMAGE> {
+  double operator() (const tDetection &d, const tGroundtruth &g, int32_t criterion) const {
+    return imageBoxOverlap(d, g, criterion);
+  }
+};
+
+template <> struct tBoxOverlap<GROUND> {
+  double operator() (const tDetection &d, const tGroundtruth &g, int32_t criterion) const {
+    return groundBoxOverlap(d, g, criterion);
+  }
+};
+
+template <> struct tBoxOverlap<BOX3D> {
+  double operator() (const tDetection &d, const tGroundtruth &g, int32_t criterion) const {
+    return box3DOverlap(d, g, criterion);
+  }
+};
+
+template <> struct tBoxOverlap<CENTER> {
+  double operator() (const tDetection &d, const tGroundtruth &g, int32_t criterion) const {
+    return centerOverlap(d, g, criterion);
+  }
+};
+
+// any other overlap function, called through its pointer
+struct tOverlapFunction {
+  double (*boxoverlap)(const tDetection&, const tGroundtruth&, int32_t);
+  double operator() (const tDetection &d, const tGroundtruth &g, int32_t criterion) const {
+    return boxoverlap(d, g, criterion);
+  }
+};
+
+// calls fn with the functor of boxoverlap: the inlinable functor of metric if boxoverlap is the
+// overlap function of metric, tOverlapFunction otherwise. fn is instantiated for every functor.
+template <typename F>
+auto withOverlap(double (*boxoverlap)(const tDetection&, const tGroundtruth&, int32_t), METRIC metric, F fn) {
+  typedef double (*tOverlapPtr)(const tDetection&, const tGroundtruth&, int32_t);
+  if (metric == IMAGE && boxoverlap == static_cast<tOverlapPtr>(imageBoxOverlap))
+    return fn(tBoxOverlap<IMAGE>());
+  if (metric == GROUND && boxoverlap == static_cast<tOverlapPtr>(groundBoxOverlap))
+    return fn(tBoxOverlap<GROUND>());
+  if (metric == BOX3D && boxoverlap == static_cast<tOverlapPtr>(box3DOverlap))
+    return fn(tBoxOverlap<BOX3D>());
+  if (metric == CENTER && boxoverlap == static_cast<tOverlapPtr>(centerOverlap))
+    return fn(tBoxOverlap<CENTER>());
+  tOverlapFunction overlap = {boxoverlap};
+  return fn(overlap);
+}
+
+// scores one ground truth box against the candidate detections cand (criterion -1), overlap[k]
+// belongs to det[cand[k]]. Pairs whose bounding circles on the ground plane are disjoint are
+// rejected four at a time with AVX when available (compile with -mavx2), only the remaining
+// pairs are clipped exactly.
+template <bool box3d>
+void rotatedBoxOverlapBatch(const tGroundtruth &g, tSpan<tDetection> det, const tBoxColumns &cols,
+        const vector<int32_t> &cand, vector<double> &overlap) {
+    const int32_t n = cand.size();
+    overlap.assign(n, 0);
+    double gc[4][2];
+    toCorners(g, gc);
+    double g_r = 0.5 * sqrt(g.l * g.l + g.w * g.w);
+
+    vector<double> x(n), z(n), r(n);
+    for (int32_t k = 0; k < n; ++k) {
+        x[k] = cols.t1[cand[k]];
+        z[k] = cols.t3[cand[k]];
+        r[k] = cols.radius[cand[k]];
+    }
+    vector<char> near(n, 1);
+    int32_t k = 0;
+#ifdef __AVX__
+    const __m256d gx = _mm256_set1_pd(g.t1), gz = _mm256_set1_pd(g.t3), gr = _mm256_set1_pd(g_r);
+    for (; k + 4 <= n; k += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(&x[k]), gx);
+        __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(&z[k]), gz);
+        __m256d rr = _mm256_add_pd(_mm256_loadu_pd(&r[k]), gr);
+        __m256d dist2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dz, dz));
+        int far = _mm256_movemask_pd(_mm256_cmp_pd(dist2, _mm256_mul_pd(rr, rr), _CMP_GT_OQ));
+        for (int l = 0; l < 4; ++l)
+            near[k + l] = !((far >> l) & 1);
+    }
+#endif
+    for (; k < n; ++k) {
+        double dx = x[k] - g.t1, dz = z[k] - g.t3, rr = r[k] + g_r;
+        near[k] = !(dx * dx + dz * dz > rr * rr);
+    }
+
+    for (k = 0; k < n; ++k) {
+        if (!near[k])
+            continue;
+        const double (*dc)[2] = (const double (*)[2])&cols.corners[8 * cand[k]];
+        overlap[k] = rotatedBoxOverlap<box3d>(det[cand[k]], g, quadIntersectionArea(gc, dc), -1);
+    }
+}
+
+// thresholds of scores v that are already sorted in descending order
+vector<double> getSortedThresholds(const vector<double> &v, double n_groundtruth){
 
   // holds scores needed to compute N_SAMPLE_PTS recall values
   vector<double> t;
 
-  // sort scores in descending order
-  // (highest score is assumed to give best/most confident detections)
-  sort(v.begin(), v.end(), greater<double>());
-
   // get scores for linearly spaced recall
   double current_recall = 0;
   for(int32_t i=0; i<v.size(); i++){
@@ -359,14 +2017,23 @@ vector<double> getThresholds(vector<double> &v, double n_groundtruth){
   return t;
 }
 
-void cleanData(
-    CLASSES current_class, 
-    const vector<tGroundtruth> &gt, 
-    const vector<tDetection> &det, 
-    vector<int32_t> &ignored_gt, 
-    vector<tGroundtruth> &dc, 
-    vector<int32_t> &ignored_det, 
-    int32_t &n_gt, 
+vector<double> getThresholds(vector<double> &v, double n_groundtruth){
+
+  tScopedTimer timer("getThresholds");
+  // sort scores in descending order
+  // (highest score is assumed to give best/most confident detections)
+  sort(v.begin(), v.end(), greater<double>());
+  return getSortedThresholds(v, n_groundtruth);
+}
+
+// ground truth half of cleanData, independent of the detections. dc holds the indices of the
+// dontcare areas in gt.
+void cleanGroundtruth(
+    CLASSES current_class,
+    tSpan<tGroundtruth> gt,
+    vector<int32_t> &ignored_gt,
+    vector<int32_t> &dc,
+    int32_t &n_gt,
     DIFFICULTY difficulty, bool depth
   ) {
 
@@ -378,13 +2045,13 @@ void cleanData(
     int32_t valid_class;
 
     // all classes without a neighboring class
-    if(!strcasecmp(gt[i].box.type.c_str(), CLASS_NAMES[current_class].c_str()))
+    if(gt[i].box.type==current_class)
       valid_class = 1;
 
     // classes with a neighboring class
-    else if(!strcasecmp(CLASS_NAMES[current_class].c_str(), "Pedestrian") && !strcasecmp("Person_sitting", gt[i].box.type.c_str()))
+    else if(current_class==PEDESTRIAN && gt[i].box.type==PERSON_SITTING_ID)
       valid_class = 0;
-    else if(!strcasecmp(CLASS_NAMES[current_class].c_str(), "Car") && !strcasecmp("Van", gt[i].box.type.c_str()))
+    else if(current_class==CAR && gt[i].box.type==VAN_ID)
       valid_class = 0;
 
     // classes not used for evaluation
@@ -425,19 +2092,26 @@ void cleanData(
 
   // extract dontcare areas
   for(int32_t i=0;i<gt.size(); i++) {
-    // cout << "Num dc " << gt[i].box.type.c_str() << endl;
-    // cout << "Add dc? " << !strcasecmp("DontCare", gt[i].box.type.c_str()) << endl;
-    if(!strcasecmp("DontCare", gt[i].box.type.c_str())) {
-      dc.push_back(gt[i]);
+    if(gt[i].box.type==DONTCARE_ID) {
+      dc.push_back(i);
     }
   }
+}
+
+// detection half of cleanData
+void cleanDetections(
+    CLASSES current_class,
+    tSpan<tDetection> det,
+    vector<int32_t> &ignored_det,
+    DIFFICULTY difficulty, bool depth
+  ) {
 
   // extract detections bounding boxes of the current class
   for(int32_t i=0;i<det.size(); i++){
 
     // neighboring classes are not evaluated
     int32_t valid_class;
-    if(!strcasecmp(det[i].box.type.c_str(), CLASS_NAMES[current_class].c_str()))
+    if(det[i].box.type==current_class)
       valid_class = 1;
     else
       valid_class = -1;
@@ -465,22 +2139,36 @@ void cleanData(
   }
 }
 
+void cleanData(
+    CLASSES current_class, 
+    tSpan<tGroundtruth> gt, 
+    tSpan<tDetection> det, 
+    vector<int32_t> &ignored_gt, 
+    vector<tGroundtruth> &dc, 
+    vector<int32_t> &ignored_det, 
+    int32_t &n_gt, 
+    DIFFICULTY difficulty, bool depth
+  ) {
+  vector<int32_t> dc_idx;
+  cleanGroundtruth(current_class, gt, ignored_gt, dc_idx, n_gt, difficulty, depth);
+  for (int32_t i : dc_idx)
+    dc.push_back(gt[i]);
+  cleanDetections(current_class, det, ignored_det, difficulty, depth);
+}
+
 void write_stat_result(
-  string outfilepre, const vector< vector<tGroundtruth> > &groundtruth, 
-  const vector< vector<tDetection> > &detection, 
-  const vector<vector<vector<int32_t> > > &tp_indices, 
-  const vector<vector<vector<int32_t> > > &fp_indices, 
-  const vector<vector<vector<int32_t> > > &fn_indices, int32_t thres_idx, int32_t frame
+  string outfilepre, const tGroundtruthStore &groundtruth, 
+  const tDetectionStore &detection, 
+  const tIndexCapture &capture, int32_t slot, int32_t frame
 ) {
   /*
-  num frames
-    num thresholds
-      detection indices (variable)
+  one row per frame of the captured threshold
+    detection indices (variable)
   */
   ofstream outfile;
   string outfilename = outfilepre + "tp.txt";
   outfile.open(outfilename);
-  for (auto tp_gt_index : tp_indices[frame][thres_idx]) {
+  for (auto tp_gt_index : capture.tp[slot][frame]) {
     outfile << setprecision(9)  << groundtruth[frame][tp_gt_index].t1 << " "
                                 << groundtruth[frame][tp_gt_index].t2 << " "
                                 << groundtruth[frame][tp_gt_index].t3 << " "
@@ -493,7 +2181,7 @@ void write_stat_result(
 
   outfilename = outfilepre + "fp.txt";
   outfile.open(outfilename);
-  for (auto fp_det_index : fp_indices[frame][thres_idx]) {
+  for (auto fp_det_index : capture.fp[slot][frame]) {
     outfile << setprecision(9)  << detection[frame][fp_det_index].t1 << " "
                                 << detection[frame][fp_det_index].t2 << " "
                                 << detection[frame][fp_det_index].t3 << " "
@@ -506,7 +2194,7 @@ void write_stat_result(
 
   outfilename = outfilepre + "fn.txt";
   outfile.open(outfilename);
-  for (auto fn_gt_index : fn_indices[frame][thres_idx]) {
+  for (auto fn_gt_index : capture.fn[slot][frame]) {
     outfile << setprecision(9)  << groundtruth[frame][fn_gt_index].t1 << " "
                                 << groundtruth[frame][fn_gt_index].t2 << " "
                                 << groundtruth[frame][fn_gt_index].t3 << " "
@@ -518,13 +2206,157 @@ void write_stat_result(
   outfile.close();
 }
 
-// default version
-tPrData computeStatistics(CLASSES current_class, const vector<tGroundtruth> &gt,
-        const vector<tDetection> &det, const vector<tGroundtruth> &dc,
-        const vector<int32_t> &ignored_gt, const vector<int32_t>  &ignored_det,
-        bool compute_fp, double (*boxoverlap)(tDetection, tGroundtruth, int32_t),
-        METRIC metric, bool compute_aos=false, double thresh=0, bool debug=false){
+/*=======================================================================
+TP/FP/FN ARCHIVE
+=======================================================================*/
+
+// An archive holds the captured tp, fp and fn boxes of all frames in a single file:
+//   tStatHeader | tStatFrame[n_frames] | frame names | double boxes t1, t2, t3, h, w, l, ry [n_boxes]
+// The boxes of a frame are its tp (ground truth), fp (detections) and fn (ground truth) boxes
+// back to back, starting at box_begin. It replaces the tp.txt, fp.txt and fn.txt files per frame.
+const char     STAT_MAGIC[8]   = {'J','R','D','B','S','T','A','T'};
+const uint32_t STAT_VERSION    = 1;
+const int32_t  STAT_BOX_FIELDS = 7;
+
+struct tStatHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t n_frames;
+  uint64_t n_boxes;
+  uint32_t names_size;
+  uint32_t reserved;
+};
+
+struct tStatFrame {
+  uint64_t box_begin;   // first box of this frame
+  uint32_t n_tp;
+  uint32_t n_fp;
+  uint32_t n_fn;
+  uint32_t name_offset; // frame name in the name table
+  uint32_t name_size;
+  uint32_t reserved;
+};
+
+// writes the boxes of slot of the capture for all frames (named by names) to path, throws on failure
+void writeStatArchive(const string &path, const tGroundtruthStore &groundtruth,
+        const tDetectionStore &detection, const vector<string> &names,
+        const tIndexCapture &capture, int32_t slot) {
+
+  tStatHeader h;
+  memset(&h, 0, sizeof(h));
+  copy(STAT_MAGIC, STAT_MAGIC+8, h.magic);
+  h.version = STAT_VERSION;
+  h.n_frames = groundtruth.size();
+
+  string strings;
+  vector<tStatFrame> frames(h.n_frames);
+  vector<double> boxes;
+  auto put_box = [&boxes](double t1, double t2, double t3, double hh, double w, double l, double ry) {
+    double fields[STAT_BOX_FIELDS] = {t1, t2, t3, hh, w, l, ry};
+    boxes.insert(boxes.end(), fields, fields + STAT_BOX_FIELDS);
+  };
+  for (size_t i = 0; i < h.n_frames; i++) {
+    tStatFrame &f = frames[i];
+    memset(&f, 0, sizeof(f));
+    f.box_begin = boxes.size() / STAT_BOX_FIELDS;
+    f.n_tp = capture.tp[slot][i].size();
+    f.n_fp = capture.fp[slot][i].size();
+    f.n_fn = capture.fn[slot][i].size();
+    f.name_offset = strings.size();
+    f.name_size = names[i].size();
+    strings += names[i];
+    for (int32_t k : capture.tp[slot][i]) {
+      const tGroundtruth &g = groundtruth[i][k];
+      put_box(g.t1, g.t2, g.t3, g.h, g.w, g.l, g.ry);
+    }
+    for (int32_t k : capture.fp[slot][i]) {
+      const tDetection &d = detection[i][k];
+      put_box(d.t1, d.t2, d.t3, d.h, d.w, d.l, d.ry);
+    }
+    for (int32_t k : capture.fn[slot][i]) {
+      const tGroundtruth &g = groundtruth[i][k];
+      put_box(g.t1, g.t2, g.t3, g.h, g.w, g.l, g.ry);
+    }
+  }
+  h.n_boxes = boxes.size() / STAT_BOX_FIELDS;
+  h.names_size = strings.size();
+
+  // written to a temporary file first, so a reader never sees a partial archive
+  string tmp_path = path + ".tmp" + to_string(getpid());
+  ofstream out(tmp_path, ios::binary);
+  if (!out)
+    throw runtime_error("Cannot write " + tmp_path);
+  size_t offset = 0;
+  auto put = [&](const void *p, size_t size) { out.write((const char*)p, size); offset += size; };
+  put(&h, sizeof(h));
+  put(frames.data(), frames.size() * sizeof(tStatFrame));
+  put(strings.data(), strings.size());
+  static const char zeros[8] = {0};
+  put(zeros, ((offset + 7) & ~(size_t)7) - offset);
+  put(boxes.data(), boxes.size() * sizeof(double));
+  out.close();
+  if (!out || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    remove(tmp_path.c_str());
+    throw runtime_error("Cannot write " + path);
+  }
+}
+
+// writes archives of one frame set (frames named by names) on background threads while the
+// evaluation goes on. The stores passed to add() must outlive the exporter, which waits for all
+// writes when it is destroyed. finish() rethrows the first failed write.
+class tStatExporter {
+public:
+  explicit tStatExporter (const vector<string> &names) : names(names) {}
+  ~tStatExporter () { join(); }
+
+  void add (const string &path, const tGroundtruthStore &groundtruth, const tDetectionStore &detection,
+            tIndexCapture capture, int32_t slot) {
+    auto capture_ptr = make_shared<tIndexCapture>(move(capture));
+    writers.emplace_back([this, path, &groundtruth, &detection, capture_ptr, slot]() {
+      tScopedTimer timer("write archive", path);
+      auto start = chrono::steady_clock::now();
+      try {
+        writeStatArchive(path, groundtruth, detection, names, *capture_ptr, slot);
+        cout << "Wrote tp, fp, fn archive " << path << " in " << secondsSince(start) << " s" << endl;
+      } catch (...) {
+        lock_guard<mutex> lock(m);
+        if (!error)
+          error = current_exception();
+      }
+    });
+  }
+
+  // waits for all pending writes, throws the error of the first one that failed
+  void finish () {
+    join();
+    if (error) {
+      exception_ptr e = error;
+      error = nullptr;
+      rethrow_exception(e);
+    }
+  }
 
+private:
+  void join () {
+    for (thread &t : writers)
+      t.join();
+    writers.clear();
+  }
+
+  const vector<string> names;
+  vector<thread>       writers;
+  mutex                m;
+  exception_ptr        error;   // of the first failed write
+};
+
+// matching of one frame at the score threshold thresh, specialized at compile time on the overlap
+// functor and the mode. Without compute_fp only TP/FN and the TP scores (v) are computed, for the
+// recall discretization. The index vectors are only filled with_indices.
+template <typename Overlap, bool compute_fp, bool compute_aos, bool with_indices>
+tPrData computeFrameStatistics(tSpan<tGroundtruth> gt, tSpan<tDetection> det, const vector<tGroundtruth> &dc,
+        const vector<int32_t> &ignored_gt, const vector<int32_t>  &ignored_det,
+        const Overlap &boxoverlap, double min_overlap, double thresh,
+        vector<int32_t> *tp_indices, vector<int32_t> *fp_indices, vector<int32_t> *fn_indices){
   tPrData stat = tPrData();
   const double NO_DETECTION = -10000000;
   vector<double> delta;            // holds angular difference for TPs (needed for AOS evaluation)
@@ -568,20 +2400,20 @@ tPrData computeStatistics(CLASSES current_class, const vector<tGroundtruth> &gt,
       double overlap = boxoverlap(det[j], gt[i], -1);
 
       // for computing recall thresholds, the candidate with highest score is considered
-      if(!compute_fp && overlap>MIN_OVERLAP[metric][current_class] && det[j].thresh>valid_detection){
+      if(!compute_fp && overlap>min_overlap && det[j].thresh>valid_detection){
         det_idx         = j;
         valid_detection = det[j].thresh;
       }
 
       // for computing pr curve values, the candidate with the greatest overlap is considered
       // if the greatest overlap is an ignored detection, the overlapping detection is used
-      else if(compute_fp && overlap>MIN_OVERLAP[metric][current_class] && (overlap>max_overlap || assigned_ignored_det) && ignored_det[j]==0){
+      else if(compute_fp && overlap>min_overlap && (overlap>max_overlap || assigned_ignored_det) && ignored_det[j]==0){
         max_overlap     = overlap;
         det_idx         = j;
         valid_detection = 1;
         assigned_ignored_det = false;
       }
-      else if(compute_fp && overlap>MIN_OVERLAP[metric][current_class] && valid_detection==NO_DETECTION && ignored_det[j]==1){
+      else if(compute_fp && overlap>min_overlap && valid_detection==NO_DETECTION && ignored_det[j]==1){
         det_idx              = j;
         valid_detection      = 1;
         assigned_ignored_det = true;
@@ -595,6 +2427,8 @@ tPrData computeStatistics(CLASSES current_class, const vector<tGroundtruth> &gt,
     // nothing was assigned to this valid ground truth
     if(valid_detection==NO_DETECTION && ignored_gt[i]==0) {
       stat.fn++;
+      if(with_indices)
+        fn_indices->push_back(i);
     }
 
     // only evaluate valid ground truth <=> detection assignments
@@ -607,6 +2441,8 @@ tPrData computeStatistics(CLASSES current_class, const vector<tGroundtruth> &gt,
       // write highest score to threshold vector
       stat.tp++;
       stat.v.push_back(det[det_idx].thresh);
+      if(with_indices)
+        tp_indices->push_back(i);
 
       // compute angular difference of detection and ground truth if valid detection orientation was provided
       if(compute_aos)
@@ -626,6 +2462,9 @@ tPrData computeStatistics(CLASSES current_class, const vector<tGroundtruth> &gt,
       // count false positives if required (height smaller than required is ignored (ignored_det==1)
       if(!(assigned_detection[i] || ignored_det[i]==-1 || ignored_det[i]==1 || ignored_threshold[i]))
         stat.fp++;
+      // the custom version always kept every detection here
+      if(with_indices)
+        fp_indices->push_back(i);
     }
 
     // do not consider detections overlapping with stuff area
@@ -643,50 +2482,1633 @@ tPrData computeStatistics(CLASSES current_class, const vector<tGroundtruth> &gt,
 
         // compute overlap and assign to stuff area, if overlap exceeds class specific value
         double overlap = boxoverlap(det[j], dc[i], 0);
-        if(overlap>MIN_OVERLAP[metric][current_class]){
+        if(overlap>min_overlap){
           assigned_detection[j] = true;
           nstuff++;
+          if(with_indices)
+            fp_indices->erase(find(fp_indices->begin(), fp_indices->end(), j));
         }
       }
     }
 
-    // FP = no. of all not to ground truth assigned detections - detections assigned to stuff areas
-    stat.fp -= nstuff;
-
-    // if all orientation values are valid, the AOS is computed
-    if(compute_aos){
-      vector<double> tmp;
-
-      // FP have a similarity of 0, for all TP compute AOS
-      tmp.assign(stat.fp, 0);
-      for(int32_t i=0; i<delta.size(); i++)
-        tmp.push_back((1.0+cos(delta[i]))/2.0);
+    // FP = no. of all not to ground truth assigned detections - detections assigned to stuff areas
+    stat.fp -= nstuff;
+
+    // if all orientation values are valid, the AOS is computed
+    if(compute_aos){
+      vector<double> tmp;
+
+      // FP have a similarity of 0, for all TP compute AOS
+      tmp.assign(stat.fp, 0);
+      for(int32_t i=0; i<delta.size(); i++)
+        tmp.push_back((1.0+cos(delta[i]))/2.0);
+
+      // be sure, that all orientation deltas are computed
+      assert(tmp.size()==stat.fp+stat.tp);
+      assert(delta.size()==stat.tp);
+
+      // get the mean orientation similarity for this image
+      if(stat.tp>0 || stat.fp>0)
+        stat.similarity = accumulate(tmp.begin(), tmp.end(), 0.0);
+
+      // there was neither a FP nor a TP, so the similarity is ignored in the evaluation
+      else
+        stat.similarity = -1;
+    }
+  }
+
+  return stat;
+}
+
+// instantiation of computeFrameStatistics for the runtime mode
+template <bool with_indices>
+tPrData computeFrameStatistics(CLASSES current_class, tSpan<tGroundtruth> gt,
+        tSpan<tDetection> det, const vector<tGroundtruth> &dc,
+        const vector<int32_t> &ignored_gt, const vector<int32_t>  &ignored_det,
+        bool compute_fp, double (*boxoverlap)(const tDetection&, const tGroundtruth&, int32_t),
+        METRIC metric, bool compute_aos, double thresh,
+        vector<int32_t> *tp_indices, vector<int32_t> *fp_indices, vector<int32_t> *fn_indices){
+  const double min_overlap = MIN_OVERLAP[metric][current_class];
+  return withOverlap(boxoverlap, metric, [&](const auto &overlap) {
+    typedef typename decay<decltype(overlap)>::type Overlap;
+    if (compute_fp && compute_aos)
+      return computeFrameStatistics<Overlap, true, true, with_indices>(gt, det, dc, ignored_gt, ignored_det, overlap, min_overlap, thresh, tp_indices, fp_indices, fn_indices);
+    if (compute_fp)
+      return computeFrameStatistics<Overlap, true, false, with_indices>(gt, det, dc, ignored_gt, ignored_det, overlap, min_overlap, thresh, tp_indices, fp_indices, fn_indices);
+    if (compute_aos)
+      return computeFrameStatistics<Overlap, false, true, with_indices>(gt, det, dc, ignored_gt, ignored_det, overlap, min_overlap, thresh, tp_indices, fp_indices, fn_indices);
+    return computeFrameStatistics<Overlap, false, false, with_indices>(gt, det, dc, ignored_gt, ignored_det, overlap, min_overlap, thresh, tp_indices, fp_indices, fn_indices);
+  });
+}
+
+// default version
+tPrData computeStatistics(CLASSES current_class, tSpan<tGroundtruth> gt,
+        tSpan<tDetection> det, const vector<tGroundtruth> &dc,
+        const vector<int32_t> &ignored_gt, const vector<int32_t>  &ignored_det,
+        bool compute_fp, double (*boxoverlap)(const tDetection&, const tGroundtruth&, int32_t),
+        METRIC metric, bool compute_aos=false, double thresh=0, bool /*debug*/=false){
+  return computeFrameStatistics<false>(current_class, gt, det, dc, ignored_gt, ignored_det, compute_fp,
+                                       boxoverlap, metric, compute_aos, thresh, NULL, NULL, NULL);
+}
+
+// custom version
+tPrData computeStatistics(CLASSES current_class, tSpan<tGroundtruth> gt,
+        tSpan<tDetection> det, const vector<tGroundtruth> &dc,
+        const vector<int32_t> &ignored_gt, const vector<int32_t>  &ignored_det,
+        bool compute_fp, double (*boxoverlap)(const tDetection&, const tGroundtruth&, int32_t),
+        METRIC metric, 
+        vector<int32_t> &tp_indices, vector<int32_t> &fp_indices, vector<int32_t> &fn_indices,
+        bool compute_aos=false, double thresh=0, bool /*debug*/=false){
+  return computeFrameStatistics<true>(current_class, gt, det, dc, ignored_gt, ignored_det, compute_fp,
+                                      boxoverlap, metric, compute_aos, thresh, &tp_indices, &fp_indices, &fn_indices);
+}
+
+/*=======================================================================
+BROAD PHASE
+=======================================================================*/
+
+// axis aligned bounds of a box: the image box for IMAGE, a square of side CENTER_MAX_DIST around
+// the center for CENTER (two centers can only match if their squares touch), the ground plane
+// (t1, t3) footprint otherwise
+template <typename T>
+inline void boxBounds(const T& b, METRIC metric, double &lo_x, double &hi_x, double &lo_y, double &hi_y) {
+  if(metric==IMAGE){
+    lo_x = min(b.box.x1, b.box.x2); hi_x = max(b.box.x1, b.box.x2);
+    lo_y = min(b.box.y1, b.box.y2); hi_y = max(b.box.y1, b.box.y2);
+    return;
+  }
+  if(metric==CENTER){
+    lo_x = b.t1 - CENTER_MAX_DIST/2; hi_x = b.t1 + CENTER_MAX_DIST/2;
+    lo_y = b.t3 - CENTER_MAX_DIST/2; hi_y = b.t3 + CENTER_MAX_DIST/2;
+    return;
+  }
+  double c[4][2];
+  toCorners(b, c);
+  lo_x = hi_x = c[0][0];
+  lo_y = hi_y = c[0][1];
+  for(int32_t k=1; k<4; k++){
+    lo_x = min(lo_x, c[k][0]); hi_x = max(hi_x, c[k][0]);
+    lo_y = min(lo_y, c[k][1]); hi_y = max(hi_y, c[k][1]);
+  }
+}
+
+// sweep-and-prune list over the detections of one frame: detections are sorted by the lower x
+// bound, so the ones whose bounds can touch a query box form a contiguous range of that order
+struct tBroadPhase {
+  const tBoxColumns &cols;     // bounds of the detections
+  vector<int32_t> order;       // detection indices sorted by lo_x
+  vector<double>  sorted_lo_x; // lo_x in that order
+  double          max_width;   // widest detection in x, bounds the start of the range
+
+  tBroadPhase (const tBoxColumns &cols, const vector<int32_t> &ignored_det) :
+    cols(cols), max_width(0) {
+    for(int32_t j=0; j<cols.lo_x.size(); j++){
+      // boxes with undefined bounds can not have a positive overlap
+      if(ignored_det[j]==-1 || !(cols.lo_x[j]<=cols.hi_x[j] && cols.lo_y[j]<=cols.hi_y[j]))
+        continue;
+      order.push_back(j);
+      max_width = max(max_width, cols.hi_x[j]-cols.lo_x[j]);
+    }
+    sort(order.begin(), order.end(), [&cols](int32_t a, int32_t b){ return cols.lo_x[a]<cols.lo_x[b]; });
+    for(int32_t j : order)
+      sorted_lo_x.push_back(cols.lo_x[j]);
+  }
+
+  // detections whose bounds touch the query bounds, in ascending index order
+  void query(double q_lo_x, double q_hi_x, double q_lo_y, double q_hi_y, vector<int32_t> &cand) const {
+    cand.clear();
+    int32_t k = lower_bound(sorted_lo_x.begin(), sorted_lo_x.end(), q_lo_x-max_width) - sorted_lo_x.begin();
+    for(; k<order.size() && sorted_lo_x[k]<=q_hi_x; k++){
+      int32_t j = order[k];
+      if(cols.hi_x[j]>=q_lo_x && cols.lo_y[j]<=q_hi_y && cols.hi_y[j]>=q_lo_y)
+        cand.push_back(j);
+    }
+    sort(cand.begin(), cand.end());
+  }
+};
+
+/*=======================================================================
+PER-FRAME OVERLAP CACHE
+=======================================================================*/
+
+// overlaps of one frame, computed once and shared by the recall and precision passes
+struct tFrameOverlaps {
+  vector<int32_t> offset;     // per ground truth start into det/overlap, offset[gt.size()] is the end
+  vector<int32_t> det;        // detection indices with a positive overlap, ascending per ground truth
+  vector<double>  overlap;    // overlap (criterion -1) of the detection with its ground truth
+  vector<double>  dc_overlap; // per detection max. overlap (criterion 0) with any dontcare area
+  int64_t         n_pairs;    // (gt, det) and (dontcare, det) pairs that had to be considered
+  int64_t         n_culled;   // pairs rejected by the broad phase without an exact overlap
+  tFrameOverlaps () :
+    n_pairs(0), n_culled(0) {}
+};
+
+// only pairs with a positive overlap are stored, which keeps the cache sparse and valid for
+// every overlap threshold (a pair with overlap<=0 can never exceed MIN_OVERLAP)
+template <typename Overlap>
+tFrameOverlaps computeFrameOverlaps(tSpan<tGroundtruth> gt, tSpan<tDetection> det,
+        const vector<int32_t> &dc, const vector<int32_t> &ignored_gt, const vector<int32_t> &ignored_det,
+        const Overlap &boxoverlap, METRIC metric) {
+
+  tFrameOverlaps ov;
+  ov.offset.assign(gt.size()+1, 0);
+  ov.dc_overlap.assign(det.size(), 0);
+
+  int32_t n_det = 0, n_valid_det = 0;
+  for(int32_t j=0; j<det.size(); j++){
+    n_det += ignored_det[j]!=-1;
+    n_valid_det += ignored_det[j]==0;
+  }
+
+  // exact overlaps are only computed for pairs whose bounds touch
+  tBoxColumns cols(det, metric);
+  tBroadPhase broad(cols, ignored_det);
+  vector<int32_t> cand;
+  vector<double> row;
+  double lo_x, hi_x, lo_y, hi_y;
+  for(int32_t i=0; i<gt.size(); i++){
+    ov.offset[i] = ov.det.size();
+    if(ignored_gt[i]==-1)
+      continue;
+    boxBounds(gt[i], metric, lo_x, hi_x, lo_y, hi_y);
+    broad.query(lo_x, hi_x, lo_y, hi_y, cand);
+    ov.n_pairs += n_det;
+    ov.n_culled += n_det - cand.size();
+#ifndef USE_BOOST_OVERLAP
+    // rotated boxes are scored against all candidates at once
+    if constexpr(is_same<Overlap, tBoxOverlap<GROUND> >::value)
+      rotatedBoxOverlapBatch<false>(gt[i], det, cols, cand, row);
+    else if constexpr(is_same<Overlap, tBoxOverlap<BOX3D> >::value)
+      rotatedBoxOverlapBatch<true>(gt[i], det, cols, cand, row);
+    else
+#endif
+    {
+      row.resize(cand.size());
+      for(int32_t k=0; k<cand.size(); k++)
+        row[k] = boxoverlap(det[cand[k]], gt[i], -1);
+    }
+    for(int32_t k=0; k<cand.size(); k++){
+      if(row[k]>0){
+        ov.det.push_back(cand[k]);
+        ov.overlap.push_back(row[k]);
+      }
+    }
+  }
+  ov.offset[gt.size()] = ov.det.size();
+
+  // only valid detections can be absorbed by stuff areas
+  for(int32_t i : dc){
+    boxBounds(gt[i], metric, lo_x, hi_x, lo_y, hi_y);
+    broad.query(lo_x, hi_x, lo_y, hi_y, cand);
+    ov.n_pairs += n_valid_det;
+    ov.n_culled += n_valid_det;
+    for(int32_t j : cand){
+      if(ignored_det[j]!=0)
+        continue;
+      ov.n_culled--;
+      double overlap = boxoverlap(det[j], gt[i], 0);
+      if(overlap>ov.dc_overlap[j])
+        ov.dc_overlap[j] = overlap;
+    }
+  }
+  return ov;
+}
+
+// same as computeStatistics(compute_fp=false), reading the overlaps from the cache
+tPrData recallStatistics(tSpan<tDetection> det, const vector<int32_t> &ignored_gt,
+        const vector<int32_t> &ignored_det, const tFrameOverlaps &ov, double min_overlap,
+        vector<pair<int32_t, int32_t> > *matches=NULL){
+
+  tPrData stat = tPrData();
+  const double NO_DETECTION = -10000000;
+  vector<bool> assigned_detection(det.size(), false);
+
+  for(int32_t i=0; i<ignored_gt.size(); i++){
+    if(ignored_gt[i]==-1)
+      continue;
+
+    // the candidate with highest score is considered
+    int32_t det_idx        = -1;
+    double valid_detection = NO_DETECTION;
+    for(int32_t k=ov.offset[i]; k<ov.offset[i+1]; k++){
+      int32_t j = ov.det[k];
+      if(assigned_detection[j])
+        continue;
+      if(ov.overlap[k]>min_overlap && det[j].thresh>valid_detection){
+        det_idx         = j;
+        valid_detection = det[j].thresh;
+      }
+    }
+
+    if(valid_detection==NO_DETECTION && ignored_gt[i]==0)
+      stat.fn++;
+    else if(valid_detection!=NO_DETECTION && (ignored_gt[i]==1 || ignored_det[det_idx]==1))
+      assigned_detection[det_idx] = true;
+    else if(valid_detection!=NO_DETECTION){
+      stat.tp++;
+      stat.v.push_back(det[det_idx].thresh);
+      assigned_detection[det_idx] = true;
+      if(matches)
+        matches->push_back(make_pair(i, det_idx));
+    }
+  }
+  return stat;
+}
+
+/*=======================================================================
+SCORE-SWEEP MATCHING
+=======================================================================*/
+
+// computes the statistics of computeStatistics(compute_fp=true) for all (descending) score
+// thresholds of one frame at once: detections are sorted by score and activated as the
+// threshold drops, and the greedy assignment is only redone when a newly active detection
+// is a candidate of some ground truth. With a capture, the TP/FP/FN indices of this frame are
+// appended as one row at each of its requested thresholds.
+template <bool compute_aos>
+void sweepStatistics(tSpan<tGroundtruth> gt, tSpan<tDetection> det,
+        const vector<int32_t> &ignored_gt, const vector<int32_t> &ignored_det,
+        const tFrameOverlaps &ov, double min_overlap,
+        const vector<double> &thresholds, vector<tPrData> &stats, tIndexCapture *capture){
+
+  const double NO_DETECTION = -10000000;
+
+  // detections that can be matched to some ground truth or are absorbed by a dontcare area
+  vector<bool> matchable(det.size(), false);
+  vector<bool> stuff(det.size(), false);
+  for(int32_t k=0; k<ov.det.size(); k++)
+    if(ov.overlap[k]>min_overlap)
+      matchable[ov.det[k]] = true;
+  for(int32_t j=0; j<det.size(); j++)
+    stuff[j] = ov.dc_overlap[j]>min_overlap;
+
+  // detections ordered by descending score, a NaN score is never below a threshold
+  vector<int32_t> order(det.size());
+  vector<double> score(det.size());
+  for(int32_t j=0; j<det.size(); j++){
+    order[j] = j;
+    score[j] = isnan(det[j].thresh) ? INFINITY : det[j].thresh;
+  }
+  stable_sort(order.begin(), order.end(), [&score](int32_t a, int32_t b){ return score[a]>score[b]; });
+
+  vector<bool> active(det.size(), false);
+  vector<bool> assigned_detection(det.size(), false);
+  vector<int32_t> tp_gt, fn_gt;
+  int32_t n_active = 0;         // prefix of order that passes the current threshold
+  int32_t n_fp_candidates = 0;  // active valid detections outside of stuff areas
+  int32_t n_assigned_fp_candidates = 0;
+  double similarity = 0;
+  bool dirty = true;
+
+  stats.assign(thresholds.size(), tPrData());
+
+  for(int32_t t=0; t<thresholds.size(); t++){
+
+    // thresholds come from getThresholds and thus never increase, restart if they do
+    if(t>0 && thresholds[t]>thresholds[t-1]){
+      active.assign(det.size(), false);
+      n_active = n_fp_candidates = 0;
+      dirty = true;
+    }
+    while(n_active<det.size() && !(score[order[n_active]]<thresholds[t])){
+      int32_t j = order[n_active++];
+      active[j] = true;
+      if(ignored_det[j]==0 && !stuff[j])
+        n_fp_candidates++;
+      if(matchable[j])
+        dirty = true;
+    }
+
+    // greedy assignment as in computeStatistics, restricted to the candidates
+    if(dirty){
+      assigned_detection.assign(det.size(), false);
+      tp_gt.clear();
+      fn_gt.clear();
+      n_assigned_fp_candidates = 0;
+      similarity = 0;
+      for(int32_t i=0; i<gt.size(); i++){
+        if(ignored_gt[i]==-1)
+          continue;
+        int32_t det_idx          = -1;
+        double valid_detection = NO_DETECTION;
+        double max_overlap     = 0;
+        bool assigned_ignored_det = false;
+        for(int32_t k=ov.offset[i]; k<ov.offset[i+1]; k++){
+          int32_t j = ov.det[k];
+          if(!active[j] || assigned_detection[j] || !(ov.overlap[k]>min_overlap))
+            continue;
+          if((ov.overlap[k]>max_overlap || assigned_ignored_det) && ignored_det[j]==0){
+            max_overlap          = ov.overlap[k];
+            det_idx              = j;
+            valid_detection      = 1;
+            assigned_ignored_det = false;
+          }
+          else if(valid_detection==NO_DETECTION && ignored_det[j]==1){
+            det_idx              = j;
+            valid_detection      = 1;
+            assigned_ignored_det = true;
+          }
+        }
+
+        if(valid_detection==NO_DETECTION && ignored_gt[i]==0)
+          fn_gt.push_back(i);
+        else if(valid_detection!=NO_DETECTION && (ignored_gt[i]==1 || ignored_det[det_idx]==1))
+          assigned_detection[det_idx] = true;
+        else if(valid_detection!=NO_DETECTION){
+          tp_gt.push_back(i);
+          if(compute_aos)
+            similarity += (1.0+cos(gt[i].box.alpha - det[det_idx].box.alpha))/2.0;
+          assigned_detection[det_idx] = true;
+        }
+        if(det_idx>=0 && assigned_detection[det_idx] && ignored_det[det_idx]==0 && !stuff[det_idx])
+          n_assigned_fp_candidates++;
+      }
+      dirty = false;
+    }
+
+    tPrData &stat = stats[t];
+    stat.tp = tp_gt.size();
+    stat.fn = fn_gt.size();
+    stat.fp = n_fp_candidates - n_assigned_fp_candidates;
+    if(compute_aos)
+      stat.similarity = (stat.tp>0 || stat.fp>0) ? similarity : -1;
+
+    const int32_t slot = capture ? capture->slot(t) : -1;
+    if(slot<0)
+      continue;
+    tIndexRows &tp = capture->tp[slot], &fp = capture->fp[slot], &fn = capture->fn[slot];
+    tp.index.insert(tp.index.end(), tp_gt.begin(), tp_gt.end());
+    fn.index.insert(fn.index.end(), fn_gt.begin(), fn_gt.end());
+    // mirrors computeStatistics, which keeps every detection in fp_indices
+    // unless it is absorbed by a stuff area
+    for(int32_t j=0; j<det.size(); j++)
+      if(!(active[j] && !assigned_detection[j] && ignored_det[j]==0 && stuff[j]))
+        fp.index.push_back(j);
+    tp.closeRow();
+    fp.closeRow();
+    fn.closeRow();
+  }
+
+  // requested thresholds beyond the last one still get an (empty) row for this frame
+  for(size_t k=0; capture && k<capture->thres_idx.size(); k++){
+    if(capture->thres_idx[k]<(int32_t)thresholds.size())
+      continue;
+    capture->tp[k].closeRow();
+    capture->fp[k].closeRow();
+    capture->fn[k].closeRow();
+  }
+}
+
+/*=======================================================================
+PARALLEL CLASS-WISE PASSES
+=======================================================================*/
+
+// frames summed by one task of the precision pass; the chunks are fixed, so partial sums are
+// merged in the same order for any no. of threads
+const int32_t FRAMES_PER_CHUNK = 32;
+
+// cleaned ground truth of all frames for one difficulty, independent of the detections and shared
+// by all prediction sets evaluated against it
+struct tGroundtruthData {
+  vector<int32_t>           n_gt_frame;  // no. of gt per frame
+  vector< vector<int32_t> > ignored_gt;  // index of ignored gt detection for current class
+  vector< vector<int32_t> > dc;          // indices of the dontcare areas per frame
+};
+
+// cleaned data and overlaps of all frames, shared by the recall and precision passes of all
+// overlap thresholds of one difficulty
+struct tClassData {
+  int32_t                   n_gt;         // total no. of gt (denominator of recall)
+  shared_ptr<const tGroundtruthData> gt;  // cleaned ground truth, shared with other passes
+  vector< vector<int32_t> > ignored_det;
+  vector<tFrameOverlaps>    overlaps;     // overlaps of all frames
+  int64_t                   n_pairs;      // broad phase counters
+  int64_t                   n_culled;
+  tClassData () :
+    n_gt(0), n_pairs(0), n_culled(0) {}
+};
+
+// cleans the ground truth of every frame, frames run in parallel
+void cleanGroundtruthData(const tGroundtruthStore &groundtruth, DIFFICULTY difficulty,
+        bool depth, int32_t n_threads, tGroundtruthData &gt_data) {
+
+  tScopedTimer timer("clean ground truth");
+  const size_t N_FRAMES = groundtruth.size();
+  gt_data = tGroundtruthData();
+  gt_data.n_gt_frame.assign(N_FRAMES, 0);
+  gt_data.ignored_gt.resize(N_FRAMES);
+  gt_data.dc.resize(N_FRAMES);
+
+  parallelFor(N_FRAMES, n_threads, [&](size_t i) {
+    CLASSES tmp_1 = (CLASSES)1;
+    cleanGroundtruth(tmp_1, groundtruth[i], gt_data.ignored_gt[i], gt_data.dc[i], gt_data.n_gt_frame[i], difficulty, depth);
+  });
+}
+
+// cleans the detections of every frame and computes its overlaps against the cleaned ground truth,
+// frames run in parallel
+void prepareClassData(const tGroundtruthStore &groundtruth,
+        const tDetectionStore &detections, shared_ptr<const tGroundtruthData> gt_data,
+        double (*boxoverlap)(const tDetection&, const tGroundtruth&, int32_t),
+        METRIC metric, DIFFICULTY difficulty, bool depth, int32_t n_threads, tClassData &data) {
+
+  tScopedTimer timer("clean detections and overlaps");
+  const size_t N_FRAMES = groundtruth.size();
+  data = tClassData();
+  data.gt = gt_data;
+  data.ignored_det.resize(N_FRAMES);
+  data.overlaps.resize(N_FRAMES);
+
+  parallelFor(N_FRAMES, n_threads, [&](size_t i) {
+    tScopedTimer frame_timer("overlaps", i);
+    CLASSES tmp_1 = (CLASSES)1;
+    // only evaluate objects of current class and ignore occluded, truncated objects
+    cleanDetections(tmp_1, detections[i], data.ignored_det[i], difficulty, depth);
+    data.overlaps[i] = withOverlap(boxoverlap, metric, [&](const auto &overlap) {
+      return computeFrameOverlaps(groundtruth[i], detections[i], gt_data->dc[i], gt_data->ignored_gt[i], data.ignored_det[i], overlap, metric);
+    });
+  });
+
+  tProfiler &profiler = tProfiler::get();
+  for (size_t i=0; i<N_FRAMES; i++){
+    data.n_gt += gt_data->n_gt_frame[i];
+    data.n_pairs += data.overlaps[i].n_pairs;
+    data.n_culled += data.overlaps[i].n_culled;
+    profiler.peak("max gt boxes per frame", groundtruth[i].size());
+    profiler.peak("max detections per frame", detections[i].size());
+  }
+  profiler.count("frames (all overlap passes)", N_FRAMES);
+  profiler.count("gt boxes (all overlap passes)", groundtruth.boxes.size());
+  profiler.count("detections (all overlap passes)", detections.boxes.size());
+  profiler.count("box pairs considered", data.n_pairs);
+  profiler.count("box pairs culled by the broad phase", data.n_culled);
+  profiler.count("overlap calls", data.n_pairs - data.n_culled);
+}
+
+// cleans every frame and computes its overlaps, frames run in parallel
+void prepareClassData(const tGroundtruthStore &groundtruth,
+        const tDetectionStore &detections,
+        double (*boxoverlap)(const tDetection&, const tGroundtruth&, int32_t),
+        METRIC metric, DIFFICULTY difficulty, bool depth, int32_t n_threads, tClassData &data) {
+  shared_ptr<tGroundtruthData> gt_data = make_shared<tGroundtruthData>();
+  cleanGroundtruthData(groundtruth, difficulty, depth, n_threads, *gt_data);
+  prepareClassData(groundtruth, detections, gt_data, boxoverlap, metric, difficulty, depth, n_threads, data);
+}
+
+// detection scores of all frames for recall discretization at the overlap threshold min_overlap
+vector<double> recallScores(const tDetectionStore &detections, const tClassData &data,
+        double min_overlap, int32_t n_threads) {
+  tScopedTimer timer("recall pass");
+  vector< vector<double> > v_frame(detections.size());
+  parallelFor(detections.size(), n_threads, [&](size_t i) {
+    v_frame[i] = recallStatistics(detections[i], data.gt->ignored_gt[i], data.ignored_det[i], data.overlaps[i], min_overlap).v;
+  });
+
+  // add detection scores to vector over all images
+  vector<double> v;
+  for (const auto &v_i : v_frame)
+    v.insert(v.end(), v_i.begin(), v_i.end());
+  return v;
+}
+
+// computes TP, FP, FN and AOS of all frames for all thresholds. Chunks of frames run in parallel,
+// every chunk sums its frames in order and the chunk sums are merged in order, so the result is
+// bit-identical for any no. of threads. The capture is optional, its rows are collected per chunk
+// and concatenated in frame order.
+void accumulateStatistics(const tGroundtruthStore &groundtruth,
+        const tDetectionStore &detections, const tClassData &data,
+        double min_overlap, const vector<double> &thresholds, bool compute_aos, int32_t n_threads,
+        vector<tPrData> &pr, tIndexCapture *capture) {
+
+  tScopedTimer timer("threshold sweep");
+  const size_t N_FRAMES = groundtruth.size();
+  const size_t N_CHUNKS = (N_FRAMES + FRAMES_PER_CHUNK - 1) / FRAMES_PER_CHUNK;
+  vector< vector<tPrData> > chunk_pr(N_CHUNKS, vector<tPrData>(thresholds.size(), tPrData()));
+  vector<tIndexCapture> chunk_capture(capture ? N_CHUNKS : 0, capture ? tIndexCapture(capture->thres_idx) : tIndexCapture());
+
+  parallelFor(N_CHUNKS, n_threads, [&](size_t c) {
+    vector<tPrData> pr_frame;
+    for (size_t i=c*FRAMES_PER_CHUNK; i<min(N_FRAMES, (c+1)*FRAMES_PER_CHUNK); i++){
+      tScopedTimer frame_timer("sweep", i);
+      // sweep all scores/recall thresholds of this frame at once
+      (compute_aos ? sweepStatistics<true> : sweepStatistics<false>)(
+                      groundtruth[i], detections[i], data.gt->ignored_gt[i], data.ignored_det[i],
+                      data.overlaps[i], min_overlap, thresholds, pr_frame,
+                      capture ? &chunk_capture[c] : NULL);
+      for(int32_t t=0; t<thresholds.size(); t++){
+        const tPrData &tmp = pr_frame[t];
+
+        // add no. of TP, FP, FN, AOS for current frame to total evaluation for current threshold
+        chunk_pr[c][t].tp += tmp.tp;
+        chunk_pr[c][t].fp += tmp.fp;
+        chunk_pr[c][t].fn += tmp.fn;
+        if(tmp.similarity!=-1)
+          chunk_pr[c][t].similarity += tmp.similarity;
+      }
+    }
+  });
+
+  pr.assign(thresholds.size(), tPrData());
+  for (size_t c=0; c<N_CHUNKS; c++){
+    for(int32_t t=0; t<thresholds.size(); t++){
+      pr[t].tp += chunk_pr[c][t].tp;
+      pr[t].fp += chunk_pr[c][t].fp;
+      pr[t].fn += chunk_pr[c][t].fn;
+      pr[t].similarity += chunk_pr[c][t].similarity;
+    }
+  }
+  if (capture) {
+    *capture = tIndexCapture(capture->thres_idx);
+    for (size_t c=0; c<N_CHUNKS; c++)
+      capture->append(chunk_capture[c]);
+  }
+}
+
+/*=======================================================================
+PER-FRAME SUFFICIENT STATISTICS
+=======================================================================*/
+
+// everything a frame contributes at one overlap threshold. The assignment of a frame only depends
+// on the set of active detections, so TP, FP and FN are step functions of the score threshold
+// that change at the frame's detection scores only. Any subset of frames can thus be evaluated at
+// its own thresholds without matching again.
+struct tFrameRecord {
+  int32_t         n_gt;       // no. of gt (denominator of recall)
+  vector<double>  v;          // scores of the detections matched by the recall pass
+  vector<double>  score;      // distinct detection scores, descending (NaN as INFINITY)
+  vector<int32_t> tp, fp, fn; // statistics with the detections of score[0..k) active, k=0..score.size()
+  vector<double>  similarity;
+};
+
+// the records of all frames at the overlap threshold min_overlap
+struct tClassRecords {
+  vector<tFrameRecord> frames;
+};
+
+// sweeps one cleaned frame over all of its detection scores
+void recordFrame(tSpan<tGroundtruth> gt, tSpan<tDetection> det,
+        const vector<int32_t> &ignored_gt, int32_t n_gt, const vector<int32_t> &ignored_det,
+        const tFrameOverlaps &ov, double min_overlap, bool compute_aos, tFrameRecord &rec) {
+
+  rec = tFrameRecord();
+  rec.n_gt = n_gt;
+  rec.v = recallStatistics(det, ignored_gt, ignored_det, ov, min_overlap).v;
+
+  for (const auto &d : det)
+    rec.score.push_back(isnan(d.thresh) ? INFINITY : d.thresh);
+  sort(rec.score.begin(), rec.score.end(), greater<double>());
+  rec.score.erase(unique(rec.score.begin(), rec.score.end()), rec.score.end());
+
+  // no active detection: every gt of the current class is missed
+  int32_t n_fn = count(ignored_gt.begin(), ignored_gt.end(), 0);
+  rec.tp.assign(1, 0);
+  rec.fp.assign(1, 0);
+  rec.fn.assign(1, n_fn);
+  rec.similarity.assign(1, compute_aos ? -1 : 0);
+
+  vector<tPrData> pr_frame;
+  (compute_aos ? sweepStatistics<true> : sweepStatistics<false>)(
+                  gt, det, ignored_gt, ignored_det, ov, min_overlap, rec.score, pr_frame, NULL);
+  for (const tPrData &stat : pr_frame) {
+    rec.tp.push_back(stat.tp);
+    rec.fp.push_back(stat.fp);
+    rec.fn.push_back(stat.fn);
+    rec.similarity.push_back(stat.similarity);
+  }
+}
+
+// sweeps every frame over all of its detection scores, frames run in parallel
+void recordStatistics(const tGroundtruthStore &groundtruth,
+        const tDetectionStore &detections, const tClassData &data,
+        double min_overlap, bool compute_aos, int32_t n_threads, tClassRecords &records) {
+
+  tScopedTimer timer("record frames");
+  records.frames.assign(groundtruth.size(), tFrameRecord());
+  parallelFor(groundtruth.size(), n_threads, [&](size_t i) {
+    tScopedTimer frame_timer("record", i);
+    recordFrame(groundtruth[i], detections[i], data.gt->ignored_gt[i], data.gt->n_gt_frame[i],
+                data.ignored_det[i], data.overlaps[i], min_overlap, compute_aos, records.frames[i]);
+  });
+}
+
+// summed errors of true positives as in nuScenes: translation is the ground plane center distance
+// (m), scale 1 - IoU of the boxes aligned in center and orientation, orientation the yaw
+// difference (rad, 0..pi). Without any true positive each mean error is 1, as in nuScenes.
+struct tTpErrors {
+  double  translation, scale, orientation;
+  int32_t n;
+  tTpErrors () :
+    translation(0), scale(0), orientation(0), n(0) {}
+  void add (const tGroundtruth &g, const tDetection &d) {
+    translation += sqrt((d.t1-g.t1)*(d.t1-g.t1) + (d.t3-g.t3)*(d.t3-g.t3));
+    double inter = min(d.l, g.l) * min(d.w, g.w) * min(d.h, g.h);
+    scale += 1 - inter / (d.l*d.w*d.h + g.l*g.w*g.h - inter);
+    double yaw = fmod(fabs(d.ry - g.ry), 2*M_PI);
+    orientation += yaw > M_PI ? 2*M_PI - yaw : yaw;
+    n++;
+  }
+  // mean of one of the summed errors
+  double mean (double sum) const { return n ? sum / n : 1; }
+  tTpErrors &operator+= (const tTpErrors &e) {
+    translation += e.translation;
+    scale += e.scale;
+    orientation += e.orientation;
+    n += e.n;
+    return *this;
+  }
+};
+
+// errors of the true positives of a cleaned CENTER frame. As in nuScenes they are matched once at
+// the largest distance CENTER_DIST[0], by the recall pass (every detection active), so every
+// level's rows get the same errors.
+tTpErrors frameTpErrors(tSpan<tGroundtruth> gt, tSpan<tDetection> det, const vector<int32_t> &ignored_gt,
+        const vector<int32_t> &ignored_det, const tFrameOverlaps &ov) {
+  vector<pair<int32_t, int32_t> > matches;
+  recallStatistics(det, ignored_gt, ignored_det, ov, MIN_OVERLAP[CENTER][0], &matches);
+  tTpErrors errors;
+  for (const auto &m : matches)
+    errors.add(gt[m.first], det[m.second]);
+  return errors;
+}
+
+// TP errors of every frame, frames run in parallel
+void tpErrorFrames(const tGroundtruthStore &groundtruth, const tDetectionStore &detections,
+        const tClassData &data, int32_t n_threads, vector<tTpErrors> &errors) {
+  tScopedTimer timer("tp errors");
+  errors.assign(groundtruth.size(), tTpErrors());
+  parallelFor(groundtruth.size(), n_threads, [&](size_t i) {
+    errors[i] = frameTpErrors(groundtruth[i], detections[i], data.gt->ignored_gt[i], data.ignored_det[i], data.overlaps[i]);
+  });
+}
+
+// errors of the true positives of the frames [begin, end)
+tTpErrors reduceTpErrors(const vector<tTpErrors> &errors, size_t begin, size_t end) {
+  tTpErrors res;
+  for (size_t i=begin; i<end; i++)
+    res += errors[i];
+  return res;
+}
+
+// recall-discretized thresholds of the frames [begin, end), as getThresholds on their matched scores
+vector<double> recordThresholds(const tClassRecords &records, size_t begin, size_t end) {
+  vector<double> v;
+  int32_t n_gt = 0;
+  for (size_t i=begin; i<end; i++){
+    v.insert(v.end(), records.frames[i].v.begin(), records.frames[i].v.end());
+    n_gt += records.frames[i].n_gt;
+  }
+  return getThresholds(v, n_gt);
+}
+
+// TP, FP, FN and AOS of the frames [begin, end) for all thresholds, summed in the chunks of
+// accumulateStatistics so the result matches it bit for bit
+void reduceStatistics(const tClassRecords &records, size_t begin, size_t end,
+        const vector<double> &thresholds, vector<tPrData> &pr) {
+
+  pr.assign(thresholds.size(), tPrData());
+  vector<tPrData> chunk_pr;
+  for (size_t c=begin; c<end; c+=FRAMES_PER_CHUNK){
+    chunk_pr.assign(thresholds.size(), tPrData());
+    for (size_t i=c; i<min(end, c+FRAMES_PER_CHUNK); i++){
+      const tFrameRecord &rec = records.frames[i];
+      for(int32_t t=0; t<thresholds.size(); t++){
+        // no. of detection scores that are not below the threshold, as in sweepStatistics
+        size_t k = partition_point(rec.score.begin(), rec.score.end(),
+                                   [&](double score){ return !(score<thresholds[t]); }) - rec.score.begin();
+        chunk_pr[t].tp += rec.tp[k];
+        chunk_pr[t].fp += rec.fp[k];
+        chunk_pr[t].fn += rec.fn[k];
+        if(rec.similarity[k]!=-1)
+          chunk_pr[t].similarity += rec.similarity[k];
+      }
+    }
+    for(int32_t t=0; t<thresholds.size(); t++){
+      pr[t].tp += chunk_pr[t].tp;
+      pr[t].fp += chunk_pr[t].fp;
+      pr[t].fn += chunk_pr[t].fn;
+      pr[t].similarity += chunk_pr[t].similarity;
+    }
+  }
+}
+
+/*=======================================================================
+OSPA
+=======================================================================*/
+
+// cut-off c and order p=1 of the OSPA distance, a pair costs at most c
+const double OSPA_CUTOFF = 1;
+
+// OSPA of one frame and its cardinality (c|m-n|/max(m,n)) and localization (assignment cost/
+// max(m,n)) terms; n_frames is 0 for a frame without any valid box, which is left out of the means
+struct tOspa {
+  double  ospa, cardinality, localization;
+  int32_t n_frames;
+  tOspa () :
+    ospa(0), cardinality(0), localization(0), n_frames(0) {}
+};
+
+// minimal total cost of assigning each of the n rows of the row-major n x m matrix cost (n<=m) to
+// a distinct column, Hungarian algorithm with potentials in O(n^2 m)
+double assignmentCost(const vector<double> &cost, int32_t n, int32_t m) {
+  vector<double> u(n+1, 0), v(m+1, 0), min_v(m+1);
+  vector<int32_t> row_of(m+1, 0), way(m+1, 0); // column 0 is the row being inserted
+  vector<char> used(m+1);
+  for (int32_t i=1; i<=n; i++){
+    row_of[0] = i;
+    int32_t j0 = 0;
+    fill(min_v.begin(), min_v.end(), INFINITY);
+    fill(used.begin(), used.end(), 0);
+    // grow the shortest alternating path until it ends in a free column
+    do {
+      used[j0] = 1;
+      int32_t i0 = row_of[j0], j1 = 0;
+      double delta = INFINITY;
+      for (int32_t j=1; j<=m; j++){
+        if (used[j])
+          continue;
+        double reduced = cost[(i0-1)*(size_t)m + (j-1)] - u[i0] - v[j];
+        if (reduced < min_v[j]) {
+          min_v[j] = reduced;
+          way[j] = j0;
+        }
+        if (min_v[j] < delta) {
+          delta = min_v[j];
+          j1 = j;
+        }
+      }
+      for (int32_t j=0; j<=m; j++){
+        if (used[j]) {
+          u[row_of[j]] += delta;
+          v[j] -= delta;
+        } else {
+          min_v[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (row_of[j0] != 0);
+    // flip the path
+    do {
+      int32_t j1 = way[j0];
+      row_of[j0] = row_of[j1];
+      j0 = j1;
+    } while (j0);
+  }
+
+  double total = 0;
+  for (int32_t j=1; j<=m; j++)
+    if (row_of[j])
+      total += cost[(row_of[j]-1)*(size_t)m + (j-1)];
+  return total;
+}
+
+// area (IMAGE), footprint (GROUND) or volume (BOX3D) of a box
+template <typename T>
+inline double boxSize(const T& b, METRIC metric) {
+  if (metric == IMAGE)
+    return (b.box.x2-b.box.x1) * (b.box.y2-b.box.y1);
+  return metric == GROUND ? b.l*b.w : b.l*b.w*b.h;
+}
+
+// OSPA of the valid gt and detections of a cleaned frame. The distance of a detection with score s
+// to a gt is 1 - s*I/(s*|D| + |G| - s*I), the score-weighted IoU of the OSPA paper cut off at c.
+// The intersection I is recovered from the cached IoU, pairs without overlap cost c.
+tOspa ospaFrame(tSpan<tGroundtruth> gt, tSpan<tDetection> det,
+        const vector<int32_t> &ignored_gt, const vector<int32_t> &ignored_det,
+        const tFrameOverlaps &ov, METRIC metric) {
+
+  vector<int32_t> gt_col(gt.size(), -1), det_col(det.size(), -1);
+  int32_t n = 0, m = 0;
+  for (int32_t i=0; i<gt.size(); i++)
+    if (ignored_gt[i]==0)
+      gt_col[i] = n++;
+  for (int32_t j=0; j<det.size(); j++)
+    if (ignored_det[j]==0)
+      det_col[j] = m++;
+
+  tOspa res;
+  if (n==0 && m==0)
+    return res;
+  res.n_frames = 1;
+  res.cardinality = OSPA_CUTOFF * abs(m-n) / max(m, n);
+  if (n>0 && m>0) {
+    // rows are the smaller set, as the solver requires
+    bool gt_rows = n<=m;
+    int32_t cols = gt_rows ? m : n;
+    vector<double> cost((size_t)min(m, n)*cols, OSPA_CUTOFF);
+    for (int32_t i=0; i<gt.size(); i++){
+      if (gt_col[i]<0)
+        continue;
+      double g_size = boxSize(gt[i], metric);
+      for (int32_t k=ov.offset[i]; k<ov.offset[i+1]; k++){
+        int32_t j = ov.det[k];
+        if (det_col[j]<0)
+          continue;
+        double d_size = boxSize(det[j], metric);
+        double iou = ov.overlap[k];
+        double inter = iou * (d_size+g_size) / (1+iou);
+        // scores outside [0, 1] are clipped, a missing score counts as certain
+        double s = isnan(det[j].thresh) ? 1 : min(1.0, max(0.0, det[j].thresh));
+        double denom = s*d_size + g_size - s*inter;
+        double dist = 1 - (denom>0 ? s*inter/denom : 0);
+        size_t idx = gt_rows ? (size_t)gt_col[i]*cols + det_col[j] : (size_t)det_col[j]*cols + gt_col[i];
+        cost[idx] = min(OSPA_CUTOFF, max(0.0, dist));
+      }
+    }
+    res.localization = assignmentCost(cost, min(m, n), cols) / max(m, n);
+  }
+  res.ospa = res.cardinality + res.localization;
+  return res;
+}
+
+// OSPA of every frame, frames run in parallel
+void ospaFrames(const tGroundtruthStore &groundtruth, const tDetectionStore &detections,
+        const tClassData &data, METRIC metric, int32_t n_threads, vector<tOspa> &ospa) {
+  tScopedTimer timer("ospa");
+  ospa.assign(groundtruth.size(), tOspa());
+  parallelFor(groundtruth.size(), n_threads, [&](size_t i) {
+    ospa[i] = ospaFrame(groundtruth[i], detections[i], data.gt->ignored_gt[i], data.ignored_det[i], data.overlaps[i], metric);
+  });
+}
+
+// mean over the frames [begin, end) with at least one box
+tOspa reduceOspa(const vector<tOspa> &ospa, size_t begin, size_t end) {
+  tOspa res;
+  for (size_t i=begin; i<end; i++){
+    res.ospa += ospa[i].ospa;
+    res.cardinality += ospa[i].cardinality;
+    res.localization += ospa[i].localization;
+    res.n_frames += ospa[i].n_frames;
+  }
+  if (res.n_frames) {
+    res.ospa /= res.n_frames;
+    res.cardinality /= res.n_frames;
+    res.localization /= res.n_frames;
+  }
+  return res;
+}
+
+// overall OSPA: the mean of the sequence means, as ospa_3d_det.py reports it
+tOspa overallOspa(const vector<tOspa> &ospa, const map<string, pair<size_t, size_t> > &seq_ranges) {
+  tOspa res;
+  int32_t n_seq = 0;
+  for (const auto &seq : seq_ranges){
+    tOspa s = reduceOspa(ospa, seq.second.first, seq.second.second);
+    if (!s.n_frames)
+      continue;
+    res.ospa += s.ospa;
+    res.cardinality += s.cardinality;
+    res.localization += s.localization;
+    res.n_frames += s.n_frames;
+    n_seq++;
+  }
+  if (n_seq) {
+    res.ospa /= n_seq;
+    res.cardinality /= n_seq;
+    res.localization /= n_seq;
+  }
+  return res;
+}
+
+/*=======================================================================
+EVALUATE CLASS-WISE
+=======================================================================*/
+
+// default version
+bool eval_class(CLASSES current_class,
+        const tGroundtruthStore &groundtruth,
+        const tDetectionStore &detections, bool compute_aos,
+        double (*boxoverlap)(const tDetection&, const tGroundtruth&, int32_t),
+        vector<double> &precision,
+        METRIC metric, DIFFICULTY difficulty, bool depth, int32_t n_threads=1,
+        const tClassData *prepared=NULL) {
+  assert(groundtruth.size() == detections.size());
+
+  // init
+  tClassData local;                                   // cleaned frames and overlaps, unless prepared by the caller
+  const tClassData &data = prepared ? *prepared : local;
+  vector<double> v, thresholds;                       // detection scores, evaluated for recall discretization
+
+  // for all test images do
+  if (!prepared)
+    prepareClassData(groundtruth, detections, boxoverlap, metric, difficulty, depth, n_threads, local);
+  v = recallScores(detections, data, MIN_OVERLAP[metric][current_class], n_threads);
+
+  // get scores that must be evaluated for recall discretization
+  thresholds = getThresholds(v, data.n_gt);
+
+  // compute TP,FP,FN for relevant scores
+  vector<tPrData> pr;
+  accumulateStatistics(groundtruth, detections, data, MIN_OVERLAP[metric][current_class], thresholds,
+                       compute_aos, n_threads, pr, NULL);
+
+  // compute recall, precision and AOS
+  precision.assign(N_SAMPLE_PTS, 0);
+  double r=0;
+  for (int32_t i=0; i<thresholds.size(); i++){
+    r = pr[i].tp/(double)(pr[i].tp + pr[i].fn);
+    precision[i] = pr[i].tp/(double)(pr[i].tp + pr[i].fp);
+  }
+
+  // filter precision and AOS using max_{i..end}(precision)
+  for (int32_t i=0; i<thresholds.size(); i++){
+    precision[i] = *max_element(precision.begin()+i, precision.end());
+  }
+
+  return true;
+}
+
+// custom version
+bool eval_class(CLASSES current_class,
+        const tGroundtruthStore &groundtruth,
+        const tDetectionStore &detections, bool compute_aos,
+        double (*boxoverlap)(const tDetection&, const tGroundtruth&, int32_t),
+        vector<double> &precision,
+        vector<double> &recall,
+        METRIC metric, DIFFICULTY difficulty, bool depth, bool write_to_file=false, int32_t n_threads=1,
+        const tClassData *prepared=NULL, tStatExporter *exporter=NULL, const string &export_path="") {
+  assert(groundtruth.size() == detections.size());
+
+  // init
+  tClassData local;                                   // cleaned frames and overlaps, unless prepared by the caller
+  const tClassData &data = prepared ? *prepared : local;
+  vector<double> v, thresholds;                       // detection scores, evaluated for recall discretization
+
+  // for all test images do
+  if (!prepared)
+    prepareClassData(groundtruth, detections, boxoverlap, metric, difficulty, depth, n_threads, local);
+  v = recallScores(detections, data, MIN_OVERLAP[metric][current_class], n_threads);
+
+  // get scores that must be evaluated for recall discretization
+  thresholds = getThresholds(v, data.n_gt);
+  // cout << "Thesholds: ";
+  // for (auto threshold : thresholds) {
+  //   cout << threshold << " ";
+  // }
+  // cout << "\n";
+  const size_t N_THRESHOLDS = thresholds.size();
+
+  // Save predictions from threshold with highest precision
+  const size_t VIS_THRES_INDEX = size_t(N_THRESHOLDS/2);
+
+  // TP/FP/FN indices are only kept for the exported threshold
+  tIndexCapture capture(vector<int32_t>(1, VIS_THRES_INDEX));
+
+  // compute TP,FP,FN for relevant scores
+  vector<tPrData> pr;
+  accumulateStatistics(groundtruth, detections, data, MIN_OVERLAP[metric][current_class], thresholds,
+                       compute_aos, n_threads, pr, write_to_file ? &capture : NULL);
+
+  // compute recall, precision and AOS
+  precision.assign(N_THRESHOLDS, 0); // potential bug, if num thresholds < N_SAMPLE_PTS
+  recall.assign(N_THRESHOLDS, 0);
+  // precision.assign(N_SAMPLE_PTS, 0); // potential bug, if num thresholds < N_SAMPLE_PTS
+  // recall.assign(N_SAMPLE_PTS, 0);
+  double r=0;
+  for (int32_t i=0; i<thresholds.size(); i++){
+    r = pr[i].tp/(double)(pr[i].tp + pr[i].fn);
+    precision[i] = pr[i].tp/(double)(pr[i].tp + pr[i].fp);
+    recall[i] = r;
+  }
+
+  // with an exporter, the boxes go to a single archive that is written in the background
+  if (write_to_file && exporter) {
+    exporter->add(export_path, groundtruth, detections, move(capture), 0);
+  } else if (write_to_file) {
+    tScopedTimer timer("write_stat_result");
+    for (size_t idx = 0; idx<groundtruth.size(); ++idx) {
+      // cout << "Saving evaluations with for frame " << to_string(frame) << " with max threshold " << to_string(max_thres_index) << '\n';
+
+      //Map idx to frame
+      string imageset_frame = gtdetidx_to_frame_map[idx];
+      // if (imageset_frame=="002308") {
+      //   cout << "idx " << idx << " frame " << imageset_frame << '\n';
+      // }
+
+      string outfilepre = "/robodata/arthurz/Benchmarks/jrdb_toolkit/detection_eval/eval_pr_out/coda2jrdbfullrangeepoch22/" + imageset_frame + "/";
+      filesystem::create_directory(outfilepre);
+
+      write_stat_result(outfilepre, groundtruth, detections, capture, 0, idx);
+    }
+    cout << "Done writing tp, fp, fn results to files\n";
+  }
+
+  // Don't apply precision filter because it amplifies precision, affecting f1 score
+  // filter precision and AOS using max_{i..end}(precision)
+  // for (int32_t i=0; i<N_THRESHOLDS; i++){
+  //   precision[i] = *max_element(precision.begin()+i, precision.end());
+  //   // recall[i] = *max_element(recall.begin()+i, recall.end());
+  // }
+
+  return true;
+}
+
+// default version: precision at the recall steps of the statistics pr of all thresholds
+void defaultPrecision(const vector<tPrData> &pr, vector<double> &precision) {
+
+  // compute recall, precision and AOS
+  precision.assign(N_SAMPLE_PTS, 0);
+  for (int32_t i=0; i<pr.size(); i++){
+    precision[i] = pr[i].tp/(double)(pr[i].tp + pr[i].fp);
+  }
+
+  // filter precision and AOS using max_{i..end}(precision)
+  for (int32_t i=0; i<pr.size(); i++){
+    precision[i] = *max_element(precision.begin()+i, precision.end());
+  }
+}
+
+// custom version: unfiltered precision and recall of the statistics pr of all thresholds
+void customPrecisionRecall(const vector<tPrData> &pr, vector<double> &precision, vector<double> &recall) {
+  precision.assign(pr.size(), 0);
+  recall.assign(pr.size(), 0);
+  for (int32_t i=0; i<pr.size(); i++){
+    precision[i] = pr[i].tp/(double)(pr[i].tp + pr[i].fp);
+    recall[i] = pr[i].tp/(double)(pr[i].tp + pr[i].fn);
+  }
+}
+
+// default version, reduced from the records of the frames [begin, end)
+bool eval_class(const tClassRecords &records, size_t begin, size_t end, vector<double> &precision) {
+
+  // get scores that must be evaluated for recall discretization
+  vector<double> thresholds = recordThresholds(records, begin, end);
+
+  // compute TP,FP,FN for relevant scores
+  vector<tPrData> pr;
+  reduceStatistics(records, begin, end, thresholds, pr);
+
+  defaultPrecision(pr, precision);
+  return true;
+}
+
+// custom version, reduced from the records of the frames [begin, end)
+bool eval_class(const tClassRecords &records, size_t begin, size_t end,
+        vector<double> &precision, vector<double> &recall) {
+
+  // get scores that must be evaluated for recall discretization
+  vector<double> thresholds = recordThresholds(records, begin, end);
+
+  // compute TP,FP,FN for relevant scores
+  vector<tPrData> pr;
+  reduceStatistics(records, begin, end, thresholds, pr);
+
+  // compute recall and precision, unfiltered as in the custom version
+  customPrecisionRecall(pr, precision, recall);
+  return true;
+}
+
+// one row of results: AP of a class over all frames or one sequence, AR and F1 for the custom
+// version and OSPA with --ospa
+struct tEvalRow {
+  string         name;        // overall or the sequence, tagged name@difficulty@overlap with --all
+  bool           has_recall;  // custom version
+  double         ap, ar, f1;
+  bool           has_tp_errors; // CENTER only
+  tTpErrors      tp_errors;
+  bool           has_ospa;
+  tOspa          ospa;
+  vector<double> precision;   // default: filtered at the recall steps, custom: at every threshold
+  vector<double> recall;      // custom only
+  // default version
+  tEvalRow (const string &name, const vector<double> &precisions) :
+    name(name), has_recall(false), ar(0), f1(0), has_tp_errors(false), has_ospa(false), precision(precisions) {
+    ap = accumulate(precisions.begin() + 1, precisions.end(), 0.0) / (N_SAMPLE_PTS - 1);
+  }
+  // custom version
+  tEvalRow (const string &name, const vector<double> &precisions, const vector<double> &recalls) :
+    name(name), has_recall(true), has_tp_errors(false), has_ospa(false), precision(precisions), recall(recalls) {
+    // fixes tp average computation
+    ap = accumulate(precisions.begin(), precisions.end(), 0.0) / (precisions.size());
+    ar = accumulate(recalls.begin(), recalls.end(), 0.0) / (recalls.size());
+    f1 = (double)(2 * ap * ar) / (ap + ar);
+  }
+};
+
+void write_result(ostream& outfile, const tEvalRow &row) {
+  outfile << row.name << "," << row.ap;
+  if (row.has_recall)
+    outfile << "," << row.ar << "," << row.f1;
+  if (row.has_tp_errors) {
+    const tTpErrors &e = row.tp_errors;
+    outfile << "," << e.mean(e.translation) << "," << e.mean(e.scale) << "," << e.mean(e.orientation);
+  }
+  if (row.has_ospa)
+    outfile << "," << row.ospa.ospa << "," << row.ospa.cardinality << "," << row.ospa.localization;
+  for (const double& prec : row.precision) {
+    outfile << ',' << prec;
+  }
+  for (const double& rec : row.recall) {
+    outfile << "," << rec;
+  }
+  outfile << endl;
+}
+
+// default version
+void write_result(ostream& outfile, string exp_name, vector<double> &precisions) {
+  write_result(outfile, tEvalRow(exp_name, precisions));
+}
+
+// custom version
+void write_result(ostream& outfile, string exp_name, vector<double> &precisions, vector<double> &recalls) {
+  write_result(outfile, tEvalRow(exp_name, precisions, recalls));
+}
+
+// rows of one class reduced from its records: the overall row (only with_overall) followed by one
+// row per sequence, default version for 2D and custom version for 3D. The rows get the OSPA of
+// their frames if the per-frame ospa is given, and the mean errors of the true positives of their
+// frames if the per-frame tp_errors are given. Progress is written to log, nothing if it is NULL.
+void recordRows(const tClassRecords &records, const map<string, pair<size_t, size_t> > &seq_ranges,
+        bool depth, int level, const string &tag, bool with_overall, vector<tEvalRow> &rows, ostream *log,
+        const vector<tOspa> *ospa = NULL, const vector<tTpErrors> *tp_errors = NULL) {
+
+  const char *dims = depth ? "3D" : "2D";
+  vector<pair<string, pair<size_t, size_t> > > ranges;
+  if (with_overall)
+    ranges.push_back(make_pair(string("overall"), make_pair((size_t)0, records.frames.size())));
+  ranges.insert(ranges.end(), seq_ranges.begin(), seq_ranges.end());
+
+  for (size_t k = 0; k < ranges.size(); k++) {
+    const string &name = ranges[k].first;
+    const pair<size_t, size_t> &range = ranges[k].second;
+    tScopedTimer timer("rows", name + tag);
+    if (log && with_overall && k == 0)
+      *log << "Starting " << dims << " evaluation (" << CLASS_NAMES[level].c_str() << tag << ") ..." << endl;
+    else if (log)
+      *log << "Starting per-sequence " << dims << " evaluation (" << name << ", " << CLASS_NAMES[level].c_str() << tag << ") ..." << endl;
+
+    vector<double> precision, recall;
+    bool ok = depth ? eval_class(records, range.first, range.second, precision, recall) :
+                      eval_class(records, range.first, range.second, precision);
+    if (!ok) {
+      if (log)
+        *log << CLASS_NAMES[level].c_str() << " evaluation failed." << endl;
+      continue;
+    }
+    if (depth)
+      rows.push_back(tEvalRow(name + tag, precision, recall));
+    else
+      rows.push_back(tEvalRow(name + tag, precision));
+    if (tp_errors) {
+      rows.back().has_tp_errors = true;
+      rows.back().tp_errors = reduceTpErrors(*tp_errors, range.first, range.second);
+    }
+    if (ospa) {
+      rows.back().has_ospa = true;
+      rows.back().ospa = with_overall && k == 0 ? overallOspa(*ospa, seq_ranges) :
+                                                  reduceOspa(*ospa, range.first, range.second);
+    }
+  }
+}
+
+/*=======================================================================
+BOOTSTRAP
+=======================================================================*/
+
+// a resample is a no. of copies per frame; its thresholds and statistics are computed from the
+// frame records with the copies as weights, so no frame is matched again
+struct tBootstrapEvent {
+  double  score;       // the statistics of frame change once its threshold drops to score
+  int32_t frame;
+  int32_t tp, fp, fn;  // change of the statistics
+};
+
+struct tBootstrapData {
+  vector<double>          v;        // matched scores of all frames, descending
+  vector<int32_t>         v_frame;  // frame of each matched score
+  vector<tBootstrapEvent> events;   // score steps of all frames, descending
+  vector<int32_t>         n_gt;     // per frame
+  vector<int32_t>         fn;       // per frame without an active detection
+};
+
+void prepareBootstrap(const tClassRecords &records, tBootstrapData &data) {
+  data = tBootstrapData();
+  vector<pair<double, int32_t> > v;
+  for (int32_t i=0; i<records.frames.size(); i++){
+    const tFrameRecord &rec = records.frames[i];
+    data.n_gt.push_back(rec.n_gt);
+    data.fn.push_back(rec.fn[0]);
+    for (double score : rec.v)
+      v.push_back(make_pair(score, i));
+    for (int32_t k=0; k<rec.score.size(); k++){
+      tBootstrapEvent e = {rec.score[k], i, rec.tp[k+1]-rec.tp[k], rec.fp[k+1]-rec.fp[k], rec.fn[k+1]-rec.fn[k]};
+      data.events.push_back(e);
+    }
+  }
+  // the order of equal scores does not matter for either
+  sort(v.begin(), v.end(), [](const pair<double, int32_t> &a, const pair<double, int32_t> &b){ return a.first > b.first; });
+  for (const auto &p : v){
+    data.v.push_back(p.first);
+    data.v_frame.push_back(p.second);
+  }
+  sort(data.events.begin(), data.events.end(), [](const tBootstrapEvent &a, const tBootstrapEvent &b){ return a.score > b.score; });
+}
+
+// TP, FP and FN of the resample with the given copies per frame for all of its thresholds, the
+// same as recordThresholds and reduceStatistics on the frames repeated that often
+void bootstrapStatistics(const tBootstrapData &data, const vector<int32_t> &copies, vector<tPrData> &pr) {
+
+  vector<double> v;
+  double n_gt = 0;
+  for (size_t i=0; i<data.v.size(); i++)
+    v.insert(v.end(), copies[data.v_frame[i]], data.v[i]);
+  tPrData total;
+  for (size_t i=0; i<copies.size(); i++){
+    n_gt += copies[i] * data.n_gt[i];
+    total.fn += copies[i] * data.fn[i];
+  }
+  vector<double> thresholds = getSortedThresholds(v, n_gt);
+
+  // thresholds and events are both descending, so one sweep activates the detections
+  pr.assign(thresholds.size(), tPrData());
+  size_t k = 0;
+  for (int32_t t=0; t<thresholds.size(); t++){
+    for (; k<data.events.size() && !(data.events[k].score<thresholds[t]); k++){
+      const tBootstrapEvent &e = data.events[k];
+      total.tp += copies[e.frame] * e.tp;
+      total.fp += copies[e.frame] * e.fp;
+      total.fn += copies[e.frame] * e.fn;
+    }
+    pr[t].tp = total.tp;
+    pr[t].fp = total.fp;
+    pr[t].fn = total.fn;
+  }
+}
+
+// percentile interval of the metrics of all resamples
+struct tBootstrapRow {
+  string name;
+  bool   has_recall;
+  double ap[2], ar[2], f1[2]; // lower and upper bound
+};
+
+// linearly interpolated quantile q of values, NaN (e.g. no detection in a resample) is left out
+double quantile(vector<double> values, double q) {
+  values.erase(remove_if(values.begin(), values.end(), [](double x){ return isnan(x); }), values.end());
+  if (values.empty())
+    return NAN;
+  sort(values.begin(), values.end());
+  double pos = q * (values.size()-1);
+  size_t lo = (size_t)pos, hi = min(lo+1, values.size()-1);
+  return values[lo] + (pos-lo) * (values[hi]-values[lo]);
+}
+
+// 95% interval of the overall row of records from n_resamples resamples of all frames (of whole
+// sequences with by_sequence). Resample r draws from its own generator seeded with (seed, r), so
+// the result does not depend on the no. of threads.
+tBootstrapRow bootstrapRow(const tClassRecords &records, const map<string, pair<size_t, size_t> > &seq_ranges,
+        bool depth, const string &name, int32_t n_resamples, bool by_sequence, uint32_t seed, int32_t n_threads) {
+
+  tScopedTimer timer("bootstrap", name);
+  tBootstrapData data;
+  prepareBootstrap(records, data);
+  vector<pair<size_t, size_t> > ranges;
+  for (const auto &seq : seq_ranges)
+    ranges.push_back(seq.second);
+
+  vector<double> ap(n_resamples), ar(n_resamples), f1(n_resamples);
+  parallelFor(n_resamples, n_threads, [&](size_t r) {
+    seed_seq seq{seed, (uint32_t)r};
+    mt19937_64 rng(seq);
+    vector<int32_t> copies(records.frames.size(), 0);
+    if (by_sequence) {
+      uniform_int_distribution<size_t> draw(0, ranges.size()-1);
+      for (size_t k=0; k<ranges.size(); k++){
+        const pair<size_t, size_t> &range = ranges[draw(rng)];
+        for (size_t i=range.first; i<range.second; i++)
+          copies[i]++;
+      }
+    } else {
+      uniform_int_distribution<size_t> draw(0, copies.size()-1);
+      for (size_t k=0; k<copies.size(); k++)
+        copies[draw(rng)]++;
+    }
+
+    vector<tPrData> pr;
+    bootstrapStatistics(data, copies, pr);
+    vector<double> precision, recall;
+    if (depth) {
+      customPrecisionRecall(pr, precision, recall);
+      tEvalRow row("", precision, recall);
+      ap[r] = row.ap; ar[r] = row.ar; f1[r] = row.f1;
+    } else {
+      defaultPrecision(pr, precision);
+      ap[r] = tEvalRow("", precision).ap;
+    }
+  });
+
+  tBootstrapRow row;
+  row.name = name;
+  row.has_recall = depth;
+  for (int32_t b=0; b<2; b++){
+    double q = b ? 0.975 : 0.025;
+    row.ap[b] = quantile(ap, q);
+    row.ar[b] = depth ? quantile(ar, q) : 0;
+    row.f1[b] = depth ? quantile(f1, q) : 0;
+  }
+  return row;
+}
+
+void write_result(ostream& outfile, const tBootstrapRow &row) {
+  outfile << row.name << "," << row.ap[0] << "," << row.ap[1];
+  if (row.has_recall)
+    outfile << "," << row.ar[0] << "," << row.ar[1] << "," << row.f1[0] << "," << row.f1[1];
+  outfile << endl;
+}
+
+/*=======================================================================
+VERIFICATION
+=======================================================================*/
+
+// boost::geometry rescales the polygons to an integer grid for robustness, so its overlaps agree
+// with the closed-form kernels to ~1e-7 only. A pair is a mismatch if it differs by more than the
+// tolerance or falls on the other side of the overlap threshold.
+const double VERIFY_OVERLAP_TOL = 1e-6;
+
+// The reference is a frozen copy of the evaluation before it was optimized: the boost::geometry
+// overlaps, cleanData and the greedy computeStatistics (default version). It shares no code with
+// the fast engine but the label types and constants, so a bug in the shared kernels or matching
+// templates shows up as a mismatch. Only the object types (interned ids, compared by name) and
+// the frame containers (spans) were adapted, calls are qualified against the global overloads and
+// the diagnostic print of cleanData (which the fast engine makes already) dropped, the code is
+// otherwise kept as it was.
+namespace reference {
+
+// criterion defines whether the overlap is computed with respect to both areas (ground truth and detection)
+// or with respect to box a or b (detection and "dontcare" areas)
+inline double imageBoxOverlap(tBox a, tBox b, int32_t criterion=-1){
+
+  // overlap is invalid in the beginning
+  double o = -1;
+
+  // get overlapping area
+  double x1 = max(a.x1, b.x1);
+  double y1 = max(a.y1, b.y1);
+  double x2 = min(a.x2, b.x2);
+  double y2 = min(a.y2, b.y2);
+
+  // compute width and height of overlapping area
+  double w = x2-x1;
+  double h = y2-y1;
+
+  // set invalid entries to 0 overlap
+  if(w<=0 || h<=0)
+    return 0;
+
+  // get overlapping areas
+  double inter = w*h;
+  double a_area = (a.x2-a.x1) * (a.y2-a.y1);
+  double b_area = (b.x2-b.x1) * (b.y2-b.y1);
+
+  // intersection over union overlap depending on users choice
+  if(criterion==-1)     // union
+    o = inter / (a_area+b_area-inter);
+  else if(criterion==0) // bbox_a
+    o = inter / a_area;
+  else if(criterion==1) // bbox_b
+    o = inter / b_area;
+
+  // overlap
+  return o;
+}
+
+inline double imageBoxOverlap(tDetection a, tGroundtruth b, int32_t criterion=-1){
+  return reference::imageBoxOverlap(a.box, b.box, criterion);
+}
+
+// compute polygon of an oriented bounding box
+template <typename T>
+Polygon toPolygon(const T& g) {
+    using namespace boost::numeric::ublas;
+    using namespace boost::geometry;
+    matrix<double> mref(2, 2);
+    mref(0, 0) = cos(g.ry); mref(0, 1) = sin(g.ry);
+    mref(1, 0) = -sin(g.ry); mref(1, 1) = cos(g.ry);
+
+    matrix<double> corners(2, 4);
+    double data[] = {g.l / 2, g.l / 2, -g.l / 2, -g.l / 2,
+                     g.w / 2, -g.w / 2, -g.w / 2, g.w / 2};
+    std::copy(data, data + 8, corners.data().begin());
+    matrix<double> gc = prod(mref, corners);
+    for (int i = 0; i < 4; ++i) {
+        gc(0, i) += g.t1;
+        gc(1, i) += g.t3;
+    }
+
+    double points[][2] = {{gc(0, 0), gc(1, 0)},{gc(0, 1), gc(1, 1)},{gc(0, 2), gc(1, 2)},{gc(0, 3), gc(1, 3)},{gc(0, 0), gc(1, 0)}};
+    Polygon poly;
+    append(poly, points);
+    return poly;
+}
+
+// measure overlap between bird's eye view bounding boxes, parametrized by (ry, l, w, tx, tz)
+inline double groundBoxOverlap(tDetection d, tGroundtruth g, int32_t criterion = -1) {
+    using namespace boost::geometry;
+    Polygon gp = reference::toPolygon(g);
+    Polygon dp = reference::toPolygon(d);
+
+    std::vector<Polygon> in, un;
+    intersection(gp, dp, in);
+    union_(gp, dp, un);
+
+    double inter_area = in.empty() ? 0 : area(in.front());
+    double union_area = area(un.front());
+    double o;
+    if(criterion==-1)     // union
+        o = inter_area / union_area;
+    else if(criterion==0) // bbox_a
+        o = inter_area / area(dp);
+    else if(criterion==1) // bbox_b
+        o = inter_area / area(gp);
+
+    return o;
+}
+
+// measure overlap between 3D bounding boxes, parametrized by (ry, h, w, l, tx, ty, tz)
+inline double box3DOverlap(tDetection d, tGroundtruth g, int32_t criterion = -1) {
+    using namespace boost::geometry;
+    Polygon gp = reference::toPolygon(g);
+    Polygon dp = reference::toPolygon(d);
+
+    std::vector<Polygon> in, un;
+    intersection(gp, dp, in);
+    union_(gp, dp, un);
+
+    double ymax = min(d.t2, g.t2);
+    double ymin = max(d.t2 - d.h, g.t2 - g.h);
+
+    double inter_area = in.empty() ? 0 : area(in.front());
+    double inter_vol = inter_area * max(0.0, ymax - ymin);
+
+    double det_vol = d.h * d.l * d.w;
+    double gt_vol = g.h * g.l * g.w;
+
+    double o;
+    if(criterion==-1)     // union
+        o = inter_vol / (det_vol + gt_vol - inter_vol);
+    else if(criterion==0) // bbox_a
+        o = inter_vol / det_vol;
+    else if(criterion==1) // bbox_b
+        o = inter_vol / gt_vol;
+
+    return o;
+}
+
+// the CENTER metric postdates the frozen evaluation, its distance is written out independently of
+// the fast engine's centerOverlap
+inline double centerOverlap(tDetection d, tGroundtruth g, int32_t /*criterion*/ = -1) {
+    double dx = d.t1 - g.t1, dz = d.t3 - g.t3;
+    return 1 - sqrt(dx*dx + dz*dz) / CENTER_MAX_DIST;
+}
+
+void cleanData(
+    CLASSES current_class, 
+    tSpan<tGroundtruth> gt, 
+    tSpan<tDetection> det, 
+    vector<int32_t> &ignored_gt, 
+    vector<tGroundtruth> &dc, 
+    vector<int32_t> &ignored_det, 
+    int32_t &n_gt, 
+    DIFFICULTY difficulty, bool depth
+  ) {
+
+  // extract ground truth bounding boxes for current evaluation class
+  for(int32_t i=0;i<gt.size(); i++){
+
+    // neighboring classes are ignored ("van" for "car" and "person_sitting" for "pedestrian")
+    // (lower/upper cases are ignored)
+    int32_t valid_class;
+
+    // all classes without a neighboring class
+    if(!strcasecmp(className(gt[i].box.type).c_str(), CLASS_NAMES[current_class].c_str()))
+      valid_class = 1;
+
+    // classes with a neighboring class
+    else if(!strcasecmp(CLASS_NAMES[current_class].c_str(), "Pedestrian") && !strcasecmp("Person_sitting", className(gt[i].box.type).c_str()))
+      valid_class = 0;
+    else if(!strcasecmp(CLASS_NAMES[current_class].c_str(), "Car") && !strcasecmp("Van", className(gt[i].box.type).c_str()))
+      valid_class = 0;
+
+    // classes not used for evaluation
+    else
+      valid_class = -1;
+    bool ignore = false;
+    bool invalid = false;
+    // 3D groundtruth filter criteria
+    if (depth) {
+      if (gt[i].num_points_3d < 0)
+        invalid = true;
+      if (gt[i].num_points_3d < MIN_3D_N_POINTS)
+        ignore = true;
+      if (gt[i].t1 * gt[i].t1 + gt[i].t3 * gt[i].t3 > MAX_3D_DIST[difficulty] * MAX_3D_DIST[difficulty])
+        ignore = true;
+    } else {
+      double height = gt[i].box.y2 - gt[i].box.y1;
+      double width = gt[i].box.x2 - gt[i].box.x1;
+      double area = width * height;
+      if (gt[i].box.x1 < 0)
+        invalid = true;
+      if (area < MIN_2D_AREA[difficulty])
+        ignore = true;
+      if (gt[i].occlusion > MAX_2D_OCC)
+        ignore = true;
+    }
+    // set ignored vector for ground truth
+    // current class and not ignored (total no. of ground truth is detected for recall denominator)
+    if(invalid)
+      ignored_gt.push_back(-1);
+    else if(valid_class==1 && !ignore){
+      ignored_gt.push_back(0);
+      n_gt++;
+    }
+    else
+      ignored_gt.push_back(1);
+  }
+
+  // extract dontcare areas
+  for(int32_t i=0;i<gt.size(); i++) {
+    if(!strcasecmp("DontCare", className(gt[i].box.type).c_str())) {
+      dc.push_back(gt[i]);
+    }
+  }
 
-      // be sure, that all orientation deltas are computed
-      assert(tmp.size()==stat.fp+stat.tp);
-      assert(delta.size()==stat.tp);
+  // extract detections bounding boxes of the current class
+  for(int32_t i=0;i<det.size(); i++){
 
-      // get the mean orientation similarity for this image
-      if(stat.tp>0 || stat.fp>0)
-        stat.similarity = accumulate(tmp.begin(), tmp.end(), 0.0);
+    // neighboring classes are not evaluated
+    int32_t valid_class;
+    if(!strcasecmp(className(det[i].box.type).c_str(), CLASS_NAMES[current_class].c_str()))
+      valid_class = 1;
+    else
+      valid_class = -1;
 
-      // there was neither a FP nor a TP, so the similarity is ignored in the evaluation
-      else
-        stat.similarity = -1;
+    bool ignore = false;
+    if (depth) {
+      if (det[i].t1 * det[i].t1 + det[i].t3 * det[i].t3 > MAX_3D_DIST[difficulty] * MAX_3D_DIST[difficulty])
+        ignore = true;
+    } else {
+      double height = det[i].box.y2 - det[i].box.y1;
+      double width = det[i].box.x2 - det[i].box.x1;
+      double area = width * height;
+      if (area < MIN_2D_AREA[difficulty])
+        ignore = true;
+    }
+    // set ignored vector for detections
+    if(ignore) {
+      ignored_det.push_back(1);
+    } else if(valid_class==1) {
+      ignored_det.push_back(0);
+    } else {
+      ignored_det.push_back(-1);
     }
   }
-
-  return stat;
 }
 
-// custom version
-tPrData computeStatistics(CLASSES current_class, const vector<tGroundtruth> &gt,
-        const vector<tDetection> &det, const vector<tGroundtruth> &dc,
+// default version
+tPrData computeStatistics(CLASSES current_class, tSpan<tGroundtruth> gt,
+        tSpan<tDetection> det, const vector<tGroundtruth> &dc,
         const vector<int32_t> &ignored_gt, const vector<int32_t>  &ignored_det,
         bool compute_fp, double (*boxoverlap)(tDetection, tGroundtruth, int32_t),
-        METRIC metric, 
-        vector<int32_t> &tp_indices, vector<int32_t> &fp_indices, vector<int32_t> &fn_indices,
-        bool compute_aos=false, double thresh=0, bool debug=false){
+        METRIC metric, bool compute_aos=false, double thresh=0, bool /*debug*/=false){
+
   tPrData stat = tPrData();
   const double NO_DETECTION = -10000000;
   vector<double> delta;            // holds angular difference for TPs (needed for AOS evaluation)
@@ -757,7 +4179,6 @@ tPrData computeStatistics(CLASSES current_class, const vector<tGroundtruth> &gt,
     // nothing was assigned to this valid ground truth
     if(valid_detection==NO_DETECTION && ignored_gt[i]==0) {
       stat.fn++;
-      fn_indices.push_back(i);
     }
 
     // only evaluate valid ground truth <=> detection assignments
@@ -770,7 +4191,6 @@ tPrData computeStatistics(CLASSES current_class, const vector<tGroundtruth> &gt,
       // write highest score to threshold vector
       stat.tp++;
       stat.v.push_back(det[det_idx].thresh);
-      tp_indices.push_back(i);
 
       // compute angular difference of detection and ground truth if valid detection orientation was provided
       if(compute_aos)
@@ -790,7 +4210,6 @@ tPrData computeStatistics(CLASSES current_class, const vector<tGroundtruth> &gt,
       // count false positives if required (height smaller than required is ignored (ignored_det==1)
       if(!(assigned_detection[i] || ignored_det[i]==-1 || ignored_det[i]==1 || ignored_threshold[i]))
         stat.fp++;
-        fp_indices.push_back(i);
     }
 
     // do not consider detections overlapping with stuff area
@@ -811,8 +4230,6 @@ tPrData computeStatistics(CLASSES current_class, const vector<tGroundtruth> &gt,
         if(overlap>MIN_OVERLAP[metric][current_class]){
           assigned_detection[j] = true;
           nstuff++;
-          auto fp_indices_it = find(fp_indices.begin(), fp_indices.end(), j);
-          fp_indices.erase(fp_indices_it);
         }
       }
     }
@@ -846,351 +4263,564 @@ tPrData computeStatistics(CLASSES current_class, const vector<tGroundtruth> &gt,
   return stat;
 }
 
-/*=======================================================================
-EVALUATE CLASS-WISE
-=======================================================================*/
-
-// default version
-bool eval_class(CLASSES current_class,
-        const vector< vector<tGroundtruth> > &groundtruth,
-        const vector< vector<tDetection> > &detections, bool compute_aos,
-        double (*boxoverlap)(tDetection, tGroundtruth, int32_t),
-        vector<double> &precision,
-        METRIC metric, DIFFICULTY difficulty, bool depth) {
-  assert(groundtruth.size() == detections.size());
-
-  // init
-  int32_t n_gt=0;                                     // total no. of gt (denominator of recall)
-  vector<double> v, thresholds;                       // detection scores, evaluated for recall discretization
-  vector< vector<int32_t> > ignored_gt, ignored_det;  // index of ignored gt detection for current class
-  vector< vector<tGroundtruth> > dontcare;            // index of dontcare areas, included in ground truth
-
-  // for all test images do
-  for (int32_t i=0; i<groundtruth.size(); i++){
-
-    // holds ignored ground truth, ignored detections and dontcare areas for current frame
-    vector<int32_t> i_gt, i_det;
-    vector<tGroundtruth> dc;
-    CLASSES tmp_1 = (CLASSES)1;
-    // only evaluate objects of current class and ignore occluded, truncated objects
-    cleanData(tmp_1, groundtruth[i], detections[i], i_gt, dc, i_det, n_gt, difficulty, depth);
-    ignored_gt.push_back(i_gt);
-    ignored_det.push_back(i_det);
-    dontcare.push_back(dc);
-
-    // compute statistics to get recall values
-    tPrData pr_tmp = tPrData();
-    pr_tmp = computeStatistics(current_class, groundtruth[i], detections[i], dc, i_gt, i_det, false, boxoverlap, metric);
+} // namespace reference
+
+// overlap of a metric in the frozen reference
+double (*referenceOverlap(METRIC metric))(tDetection, tGroundtruth, int32_t) {
+  if (metric == CENTER)
+    return reference::centerOverlap;
+  if (metric == BOX3D)
+    return reference::box3DOverlap;
+  if (metric == GROUND)
+    return reference::groundBoxOverlap;
+  return reference::imageBoxOverlap;
+}
 
-    // add detection scores to vector over all images
-    for(int32_t j=0; j<pr_tmp.v.size(); j++)
-      v.push_back(pr_tmp.v[j]);
+// first mismatch found in one frame
+struct tMismatch {
+  bool    found;
+  string  what;
+  tMismatch () : found(false) {}
+  void set (const string &description) {
+    if (!found) {
+      found = true;
+      what = description;
+    }
   }
-  // cout << "ignored gt " << ignored_gt.size() << " ignored det " << ignored_det.size() << " dontcare " << dontcare.size() << endl;
-  // get scores that must be evaluated for recall discretization
-  thresholds = getThresholds(v, n_gt);
+};
 
-  // compute TP,FP,FN for relevant scores
-  vector<tPrData> pr;
-  pr.assign(thresholds.size(),tPrData());
-  for (int32_t i=0; i<groundtruth.size(); i++){
+// reference side of one verified frame
+struct tVerifyFrame {
+  vector<int32_t>      ignored_gt, ignored_det;
+  vector<tGroundtruth> dc;
+  int32_t              n_gt;
+  vector<double>       v;                  // matched scores of the recall pass
+  vector<tPrData>      pr;                 // per threshold
+  int64_t              n_pairs, n_overlap_mismatches, n_stat_mismatches;
+  double               max_overlap_delta;
+  tMismatch            mismatch;
+  tVerifyFrame () :
+    n_gt(0), n_pairs(0), n_overlap_mismatches(0), n_stat_mismatches(0), max_overlap_delta(0) {}
+};
 
-    // for all scores/recall thresholds do:
-    for(int32_t t=0; t<thresholds.size(); t++){
-      tPrData tmp = tPrData();
-      tmp = computeStatistics(current_class, groundtruth[i], detections[i], dontcare[i],
-                              ignored_gt[i], ignored_det[i], true, boxoverlap, metric,
-                              compute_aos, thresholds[t], t==38);
+// cleaning, overlaps and recall pass of a frame against the fast engine's data and record
+void verifyFrame(tSpan<tGroundtruth> gt, tSpan<tDetection> det, const tClassData &data,
+        const tFrameRecord &rec, size_t i, CLASSES cls, METRIC metric, DIFFICULTY difficulty, bool depth,
+        tVerifyFrame &ref) {
+
+  double (*overlap)(tDetection, tGroundtruth, int32_t) = referenceOverlap(metric);
+  const double min_overlap = MIN_OVERLAP[metric][cls];
+  const tFrameOverlaps &ov = data.overlaps[i];
+
+  CLASSES tmp_1 = (CLASSES)1;
+  reference::cleanData(tmp_1, gt, det, ref.ignored_gt, ref.dc, ref.ignored_det, ref.n_gt, difficulty, depth);
+  if (ref.ignored_gt != data.gt->ignored_gt[i] || ref.ignored_det != data.ignored_det[i] || ref.n_gt != data.gt->n_gt_frame[i]) {
+    ref.mismatch.set("cleaning differs");
+    ref.n_stat_mismatches++;
+    return;
+  }
 
-      // add no. of TP, FP, FN, AOS for current frame to total evaluation for current threshold
-      pr[t].tp += tmp.tp;
-      pr[t].fp += tmp.fp;
-      pr[t].fn += tmp.fn;
-      if(tmp.similarity!=-1)
-        pr[t].similarity += tmp.similarity;
+  // every pair the matching can look at
+  for (int32_t g=0; g<gt.size(); g++){
+    if (ref.ignored_gt[g]==-1)
+      continue;
+    for (int32_t j=0; j<det.size(); j++){
+      if (ref.ignored_det[j]==-1)
+        continue;
+      double expected = overlap(det[j], gt[g], -1), actual = 0;
+      for (int32_t k=ov.offset[g]; k<ov.offset[g+1]; k++)
+        if (ov.det[k]==j)
+          actual = ov.overlap[k];
+      double delta = fabs(expected - max(0.0, actual));
+      if (!(expected > 0) && actual == 0)
+        delta = 0;
+      ref.n_pairs++;
+      ref.max_overlap_delta = max(ref.max_overlap_delta, delta);
+      if (delta > VERIFY_OVERLAP_TOL || (expected > min_overlap) != (actual > min_overlap)) {
+        ref.n_overlap_mismatches++;
+        ostringstream s;
+        s << setprecision(17) << "overlap of gt " << g << " and detection " << j << ": reference " << expected
+          << ", fast " << actual << ", delta " << delta;
+        ref.mismatch.set(s.str());
+      }
     }
   }
-
-  // compute recall, precision and AOS
-  precision.assign(N_SAMPLE_PTS, 0);
-  double r=0;
-  for (int32_t i=0; i<thresholds.size(); i++){
-    r = pr[i].tp/(double)(pr[i].tp + pr[i].fn);
-    precision[i] = pr[i].tp/(double)(pr[i].tp + pr[i].fp);
+  for (int32_t j=0; j<det.size(); j++){
+    if (ref.ignored_det[j]!=0)
+      continue;
+    double expected = 0;
+    for (const tGroundtruth &d : ref.dc)
+      expected = max(expected, overlap(det[j], d, 0));
+    double delta = fabs(expected - ov.dc_overlap[j]);
+    ref.max_overlap_delta = max(ref.max_overlap_delta, delta);
+    if (delta > VERIFY_OVERLAP_TOL || (expected > min_overlap) != (ov.dc_overlap[j] > min_overlap)) {
+      ref.n_overlap_mismatches++;
+      ostringstream s;
+      s << setprecision(17) << "dontcare overlap of detection " << j << ": reference " << expected
+        << ", fast " << ov.dc_overlap[j] << ", delta " << delta;
+      ref.mismatch.set(s.str());
+    }
   }
 
-  // filter precision and AOS using max_{i..end}(precision)
-  for (int32_t i=0; i<thresholds.size(); i++){
-    precision[i] = *max_element(precision.begin()+i, precision.end());
+  ref.v = reference::computeStatistics(cls, gt, det, ref.dc, ref.ignored_gt, ref.ignored_det, false, overlap, metric).v;
+  vector<double> expected(ref.v), actual(rec.v);
+  sort(expected.begin(), expected.end());
+  sort(actual.begin(), actual.end());
+  if (expected != actual) {
+    ref.n_stat_mismatches++;
+    ref.mismatch.set("matched scores of the recall pass differ (" + to_string(expected.size()) + " reference, " +
+                     to_string(actual.size()) + " fast)");
   }
-
-  return true;
 }
 
-// custom version
-bool eval_class(CLASSES current_class,
-        const vector< vector<tGroundtruth> > &groundtruth,
-        const vector< vector<tDetection> > &detections, bool compute_aos,
-        double (*boxoverlap)(tDetection, tGroundtruth, int32_t),
-        vector<double> &precision,
-        vector<double> &recall,
-        METRIC metric, DIFFICULTY difficulty, bool depth, bool write_to_file=false) {
-  assert(groundtruth.size() == detections.size());
-
-  // init
-  int32_t n_gt=0;                                     // total no. of gt (denominator of recall)
-  vector<double> v, thresholds;                       // detection scores, evaluated for recall discretization
-  vector< vector<int32_t> > ignored_gt, ignored_det;  // index of ignored gt detection for current class
-  vector< vector<tGroundtruth> > dontcare;            // index of dontcare areas, included in ground truth
-
-  vector<int32_t> tmp_tp_indices;
-  vector<int32_t> tmp_fp_indices;
-  vector<int32_t> tmp_fn_indices;
-
-  // for all test images do
-  for (int32_t i=0; i<groundtruth.size(); i++){
-
-    // holds ignored ground truth, ignored detections and dontcare areas for current frame
-    vector<int32_t> i_gt, i_det;
-    vector<tGroundtruth> dc;
-    CLASSES tmp_1 = (CLASSES)1;
-    // only evaluate objects of current class and ignore occluded, truncated objects
-    cleanData(tmp_1, groundtruth[i], detections[i], i_gt, dc, i_det, n_gt, difficulty, depth);
-    ignored_gt.push_back(i_gt);
-    ignored_det.push_back(i_det);
-    dontcare.push_back(dc);
-
-    // compute statistics to get recall values
-    tPrData pr_tmp = tPrData();
-    pr_tmp = computeStatistics(current_class, groundtruth[i], detections[i], dc, i_gt, i_det, false, boxoverlap, metric, tmp_tp_indices, tmp_fp_indices, tmp_fn_indices);
-    // pr_tmp = computeStatistics(current_class, groundtruth[i], detections[i], dc, i_gt, i_det, true, boxoverlap, metric); // compute recall for this
-    //Empty temp stat vectors
-    tmp_tp_indices.clear();
-    tmp_fp_indices.clear();
-    tmp_fn_indices.clear();
-
-    // add detection scores to vector over all images
-    for(int32_t j=0; j<pr_tmp.v.size(); j++)
-      v.push_back(pr_tmp.v[j]);
-  }
-  // cout << "ignored gt " << ignored_gt.size() << " ignored det " << ignored_det.size() << " dontcare " << dontcare.size() << endl;
-  // get scores that must be evaluated for recall discretization
-  thresholds = getThresholds(v, n_gt);
-  // cout << "Thesholds: ";
-  // for (auto threshold : thresholds) {
-  //   cout << threshold << " ";
-  // }
-  // cout << "\n";
-  const size_t N_FRAMES = groundtruth.size();
-  const size_t N_THRESHOLDS = thresholds.size();
-  vector<vector<vector<int32_t> > > tp_indices(N_FRAMES, vector<vector<int32_t> >(N_THRESHOLDS, vector<int32_t>()) );
-  vector<vector<vector<int32_t> > > fp_indices(N_FRAMES, vector<vector<int32_t> >(N_THRESHOLDS, vector<int32_t>()) );
-  vector<vector<vector<int32_t> > > fn_indices(N_FRAMES, vector<vector<int32_t> >(N_THRESHOLDS, vector<int32_t>()) );
-
-  // compute TP,FP,FN for relevant scores
-  vector<tPrData> pr;
-  pr.assign(thresholds.size(),tPrData());
-  for (int32_t i=0; i<groundtruth.size(); i++){
-    // for all scores/recall thresholds do:
-    for(int32_t t=0; t<thresholds.size(); t++){
-      tPrData tmp = tPrData();
-      tmp = computeStatistics(current_class, groundtruth[i], detections[i], dontcare[i],
-                              ignored_gt[i], ignored_det[i], true, boxoverlap, metric,
-                              tp_indices[i][t], fp_indices[i][t], fn_indices[i][t],
-                              compute_aos, thresholds[t], t==38);
-      // add no. of TP, FP, FN, AOS for current frame to total evaluation for current threshold
-      pr[t].tp += tmp.tp;
-      pr[t].fp += tmp.fp;
-      pr[t].fn += tmp.fn;
-      // if (tp_indices[i][t].size()>0) 
-      //   cout << "tp indices " << t << " parent func size " << tp_indices[i][t].size() << '\n';
-      if(tmp.similarity!=-1)
-        pr[t].similarity += tmp.similarity;
+// runs the frozen reference evaluation (reference::cleanData, reference::computeStatistics with the
+// boost::geometry overlaps, getThresholds) on the frames of subset and compares every step with the records of the fast
+// engine: cleaning, overlaps, matched scores, thresholds, TP/FP/FN per threshold and the metrics.
+// Prints the counts and the first mismatch in frame order, returns whether everything matched.
+bool verifyRecords(const tGroundtruthStore &groundtruth, const tDetectionStore &detections,
+        const tClassData &data, const tClassRecords &records, const vector<size_t> &subset,
+        const vector<string> &names, CLASSES cls, METRIC metric, DIFFICULTY difficulty, bool depth,
+        const string &tag, int32_t n_threads) {
+
+  tScopedTimer timer("verify", tag);
+  double (*overlap)(tDetection, tGroundtruth, int32_t) = referenceOverlap(metric);
+
+  vector<tVerifyFrame> ref(subset.size());
+  parallelFor(subset.size(), n_threads, [&](size_t k) {
+    size_t i = subset[k];
+    verifyFrame(groundtruth[i], detections[i], data, records.frames[i], i, cls, metric, difficulty, depth, ref[k]);
+  });
+
+  // thresholds of the subset, from the reference recall pass and from the records
+  vector<double> v;
+  int32_t n_gt = 0;
+  tClassRecords fast;
+  for (size_t k=0; k<subset.size(); k++){
+    v.insert(v.end(), ref[k].v.begin(), ref[k].v.end());
+    n_gt += ref[k].n_gt;
+    fast.frames.push_back(records.frames[subset[k]]);
+  }
+  vector<double> thresholds = getThresholds(v, n_gt);
+  vector<double> fast_thresholds = recordThresholds(fast, 0, fast.frames.size());
+  tMismatch threshold_mismatch;
+  if (thresholds != fast_thresholds)
+    threshold_mismatch.set("thresholds differ (" + to_string(thresholds.size()) + " reference, " +
+                           to_string(fast_thresholds.size()) + " fast)");
+
+  parallelFor(subset.size(), n_threads, [&](size_t k) {
+    size_t i = subset[k];
+    const tFrameRecord &rec = records.frames[i];
+    tVerifyFrame &r = ref[k];
+    if (r.ignored_gt != data.gt->ignored_gt[i] || r.ignored_det != data.ignored_det[i])
+      return;
+    for (int32_t t=0; t<thresholds.size(); t++){
+      r.pr.push_back(reference::computeStatistics(cls, groundtruth[i], detections[i], r.dc, r.ignored_gt, r.ignored_det,
+                                       true, overlap, metric, false, thresholds[t]));
+      size_t s = partition_point(rec.score.begin(), rec.score.end(),
+                                 [&](double score){ return !(score<thresholds[t]); }) - rec.score.begin();
+      const tPrData &e = r.pr.back();
+      if (e.tp != rec.tp[s] || e.fp != rec.fp[s] || e.fn != rec.fn[s]) {
+        r.n_stat_mismatches++;
+        ostringstream d;
+        d << setprecision(17) << "threshold " << t << " (" << thresholds[t] << "): reference tp/fp/fn "
+          << e.tp << "/" << e.fp << "/" << e.fn << ", fast " << rec.tp[s] << "/" << rec.fp[s] << "/" << rec.fn[s];
+        r.mismatch.set(d.str());
+      }
+    }
+  });
+
+  // metrics of the subset, reference summed in frame order
+  int64_t n_pairs = 0, n_overlap_mismatches = 0, n_stat_mismatches = 0;
+  double max_overlap_delta = 0;
+  string first;
+  vector<tPrData> pr(thresholds.size(), tPrData());
+  for (size_t k=0; k<subset.size(); k++){
+    n_pairs += ref[k].n_pairs;
+    n_overlap_mismatches += ref[k].n_overlap_mismatches;
+    n_stat_mismatches += ref[k].n_stat_mismatches;
+    max_overlap_delta = max(max_overlap_delta, ref[k].max_overlap_delta);
+    if (first.empty() && ref[k].mismatch.found)
+      first = "frame " + names[subset[k]] + ": " + ref[k].mismatch.what;
+    for (size_t t=0; t<ref[k].pr.size(); t++){
+      pr[t].tp += ref[k].pr[t].tp;
+      pr[t].fp += ref[k].pr[t].fp;
+      pr[t].fn += ref[k].pr[t].fn;
     }
   }
-
-  // compute recall, precision and AOS
-  precision.assign(N_THRESHOLDS, 0); // potential bug, if num thresholds < N_SAMPLE_PTS
-  recall.assign(N_THRESHOLDS, 0);
-  // precision.assign(N_SAMPLE_PTS, 0); // potential bug, if num thresholds < N_SAMPLE_PTS
-  // recall.assign(N_SAMPLE_PTS, 0);
-  double r=0;
-  for (int32_t i=0; i<thresholds.size(); i++){
-    r = pr[i].tp/(double)(pr[i].tp + pr[i].fn);
-    precision[i] = pr[i].tp/(double)(pr[i].tp + pr[i].fp);
-    recall[i] = r;
+  if (first.empty() && threshold_mismatch.found)
+    first = threshold_mismatch.what;
+
+  vector<double> precision, recall, fast_precision, fast_recall;
+  double ap_delta, ar_delta = 0, f1_delta = 0;
+  if (depth) {
+    customPrecisionRecall(pr, precision, recall);
+    eval_class(fast, 0, fast.frames.size(), fast_precision, fast_recall);
+    tEvalRow expected("", precision, recall), actual("", fast_precision, fast_recall);
+    ap_delta = actual.ap - expected.ap;
+    ar_delta = actual.ar - expected.ar;
+    f1_delta = actual.f1 - expected.f1;
+  } else {
+    defaultPrecision(pr, precision);
+    eval_class(fast, 0, fast.frames.size(), fast_precision);
+    ap_delta = tEvalRow("", fast_precision).ap - tEvalRow("", precision).ap;
   }
+  bool metrics_equal = (ap_delta == 0 || isnan(ap_delta)) && (ar_delta == 0 || isnan(ar_delta)) &&
+                       (f1_delta == 0 || isnan(f1_delta));
+  if (first.empty() && !metrics_equal)
+    first = "metrics differ";
+
+  cout << "Verified " << CLASS_NAMES[cls] << tag << " on " << subset.size() << " frames: " << n_pairs
+       << " box pairs (max. overlap delta " << max_overlap_delta << ", " << n_overlap_mismatches << " mismatches), "
+       << thresholds.size() << " thresholds (" << n_stat_mismatches << " frame mismatches), delta AP "
+       << ap_delta << " AR " << ar_delta << " F1 " << f1_delta << endl;
+  if (!first.empty())
+    cout << "First mismatch: " << first << endl;
+  return first.empty();
+}
 
-  // Save predictions from threshold with highest precision
-  const size_t VIS_THRES_INDEX = size_t(N_THRESHOLDS/2);
-
-  if (write_to_file) {
-    for (size_t idx = 0; idx<groundtruth.size(); ++idx) {
-      // cout << "Saving evaluations with for frame " << to_string(frame) << " with max threshold " << to_string(max_thres_index) << '\n';
-
-      //Map idx to frame
-      string imageset_frame = gtdetidx_to_frame_map[idx];
-      // if (imageset_frame=="002308") {
-      //   cout << "idx " << idx << " frame " << imageset_frame << '\n';
-      // }
-
-      string outfilepre = "/robodata/arthurz/Benchmarks/jrdb_toolkit/detection_eval/eval_pr_out/coda2jrdbfullrangeepoch22/" + imageset_frame + "/";
-      filesystem::create_directory(outfilepre);
-
-      write_stat_result(outfilepre, groundtruth, detections, tp_indices, fp_indices, fn_indices, VIS_THRES_INDEX, idx);
-    }
-    cout << "Done writing tp, fp, fn results to files\n";
+// frames checked by --verify=N: N of them drawn with the seed, all if N is 0 or not smaller
+vector<size_t> verifySubset(size_t n_frames, int32_t n_verify, uint32_t seed) {
+  vector<size_t> subset(n_frames);
+  iota(subset.begin(), subset.end(), 0);
+  if (n_verify > 0 && (size_t)n_verify < n_frames) {
+    mt19937_64 rng(seed);
+    shuffle(subset.begin(), subset.end(), rng);
+    subset.resize(n_verify);
+    sort(subset.begin(), subset.end());
   }
-
-  // Don't apply precision filter because it amplifies precision, affecting f1 score
-  // filter precision and AOS using max_{i..end}(precision)
-  // for (int32_t i=0; i<N_THRESHOLDS; i++){
-  //   precision[i] = *max_element(precision.begin()+i, precision.end());
-  //   // recall[i] = *max_element(recall.begin()+i, recall.end());
-  // }
-
-  return true;
+  return subset;
 }
 
-// default version
-void write_result(ofstream& outfile, string exp_name, vector<double> &precisions) {
-  double ap = accumulate(precisions.begin() + 1, precisions.end(), 0.0) / (N_SAMPLE_PTS - 1);
-  outfile << exp_name << "," << ap ;
-  for (const double& prec : precisions) {
-    outfile << ',' << prec;
+// ground truth of an evaluation run, loaded and cleaned once and shared by every prediction set
+// evaluated against it
+struct tGroundtruthSet {
+  tGroundtruthStore                           groundtruths; // all frames, sorted by sequence and frame
+  vector<pair<string, string> >               frames;       // (sequence, frame) names of the frames
+  map<string, pair<size_t, size_t> >          seq_ranges;   // sequences are contiguous ranges of the frames
+  vector<DIFFICULTY>                          difficulties; // evaluated difficulties
+  vector<shared_ptr<const tGroundtruthData> > cleaned;      // cleaned ground truth per evaluated difficulty
+};
+
+// evaluated difficulties and overlap thresholds (columns of MIN_OVERLAP), every combination with --all
+void evalLevels(int c, const tEvalOptions &options, vector<DIFFICULTY> &difficulties, vector<int> &levels) {
+  difficulties.assign(1, HARD);
+  levels.assign(1, c);
+  if (options.all_levels) {
+    difficulties = {EASY, HARD};
+    levels = {0, 1, 2};
   }
-  outfile << endl;
 }
 
-// custom version
-void write_result(ofstream& outfile, string exp_name, vector<double> &precisions, vector<double> &recalls) {
-  // fixes tp average computation
-  double ap = accumulate(precisions.begin(), precisions.end(), 0.0) / (precisions.size());
-  double ar = accumulate(recalls.begin(), recalls.end(), 0.0) / (recalls.size());
-  double af1 = (double)(2 * ap * ar) / (ap + ar);
-  outfile << exp_name << "," << ap << "," << ar << "," << af1;
-  for (const double& prec : precisions) {
-    outfile << ',' << prec;
+void loadGroundtruthSet(string gt_dir, int c, bool depth, const tEvalOptions &options, tGroundtruthSet &gt) {
+
+  cout << "Loading data" << endl;
+  loadGroundtruthTree(gt_dir, options, gt.groundtruths, gt.frames);
+  for (size_t idx = 0; idx < gt.frames.size(); ++idx) {
+    const string &sequence = gt.frames[idx].first, &frame = gt.frames[idx].second;
+    //Build 1to1 map from groundtruths indices to frames in imagesets
+    size_t dotPosition = frame.find('.');
+    gtdetidx_to_frame_map[idx] = frame.substr(0, dotPosition);
+
+    auto it = gt.seq_ranges.insert(make_pair(sequence, make_pair(idx, idx))).first;
+    it->second.second = idx + 1;
   }
-  for (const double& rec : recalls) {
-    outfile << "," << rec;
+  cout << "Num gt files " << gt.groundtruths.size() << endl;
+  if (gt.groundtruths.size() != N_TESTIMAGES) {
+    throw invalid_argument("Mismatch in number of ground truth files.");
+  }
+
+  vector<int> levels;
+  evalLevels(c, options, gt.difficulties, levels);
+  for (size_t d = 0; d < gt.difficulties.size(); d++) {
+    shared_ptr<tGroundtruthData> cleaned = make_shared<tGroundtruthData>();
+    cleanGroundtruthData(gt.groundtruths, gt.difficulties[d], depth, options.n_threads, *cleaned);
+    gt.cleaned.push_back(cleaned);
   }
-  outfile << endl;
 }
 
-void eval(string gt_dir, string result_dir, int c, bool depth, ofstream& outfile) {
+// rows are tagged with difficulty and overlap threshold if several are evaluated
+string levelTag(const tEvalOptions &options, DIFFICULTY difficulty, METRIC metric, int level) {
+  if (!options.all_levels)
+    return "";
+  ostringstream tag_stream;
+  tag_stream << '@' << (difficulty == EASY ? "easy" : "hard") << '@';
+  if (metric == CENTER)
+    tag_stream << CENTER_DIST[level] << 'm';
+  else
+    tag_stream << MIN_OVERLAP[metric][level];
+  return tag_stream.str();
+}
 
-  vector<vector<tGroundtruth>> groundtruths;
-  vector<vector<tDetection>> detections;
-  map<string, vector<vector<tGroundtruth>>> groundtruths_perseq;
-  map<string, vector<vector<tDetection>>> detections_perseq;
+// evaluates one prediction set against the loaded ground truth, the tp/fp/fn boxes are exported
+// with export_stats only (to the archive options.export_path if set, else to one directory per frame).
+// Returns false if --verify found a mismatch, throws if the archive could not be written.
+bool evalPredictions(const tGroundtruthSet &gt, const tDetectionStore &detections,
+        int c, bool depth, const tEvalOptions &options, bool export_stats, ofstream& outfile) {
+
+  tScopedTimer timer("evaluate predictions");
+
+  // the archive is written while the remaining levels and sequences are evaluated, its frames are
+  // named <sequence>/<frame>
+  vector<string> names;
+  for (const auto &frame : gt.frames)
+    names.push_back(frame.first + '/' + frame.second.substr(0, frame.second.find('.')));
+  tProfiler::get().setFrames(names);
+  tStatExporter exporter(names);
+  bool verified = true;
+  vector<size_t> verify_subset;
+  if (options.verify >= 0)
+    verify_subset = verifySubset(gt.frames.size(), options.verify, options.seed);
+
+  for (size_t idx = 0; idx < gt.frames.size(); ++idx) {
+    const string &sequence = gt.frames[idx].first, &frame = gt.frames[idx].second;
+    if (frame=="002308.txt") {
+      cout << "sequence " << sequence << " idx " << idx << '\n';
+      cout << "num boxes in frame " << frame << " gt size " << gt.groundtruths[idx].size() << " dt size " << detections[idx].size() << '\n';
+    }
+  }
+  cout << "Loaded data" << endl;
 
-  cout << "Loading data" << endl;
-  string path;
-  vector<string> sequences = list_dir(gt_dir);
-  size_t idx = 0;
-  for (const auto& sequence : sequences) {
-    vector<string> frames = list_dir(gt_dir + '/' + sequence);
-   
-    vector<vector<tGroundtruth>> groundtruths_seq;
-    vector<vector<tDetection>> detections_seq;
-    for (const auto& frame : frames) {
-      string gt_path = gt_dir + '/' + sequence + '/' + frame;
-      string result_path = "";
-      if (depth) {
-        result_path = result_dir + '/' + sequence + '/' + frame;
+  vector<DIFFICULTY> difficulties;
+  vector<int> levels;
+  evalLevels(c, options, difficulties, levels);
+  METRIC metric = depth ? (options.center ? CENTER : BOX3D) : IMAGE;
+  double (*boxoverlap)(const tDetection&, const tGroundtruth&, int32_t) = box3DOverlap;
+  if (!depth)
+    boxoverlap = imageBoxOverlap;
+  else if (options.center)
+    boxoverlap = centerOverlap;
+
+  for (size_t d = 0; d < difficulties.size(); d++) {
+    DIFFICULTY difficulty = difficulties[d];
+
+    // detections are cleaned and their overlaps computed once for all overlap thresholds
+    tClassData data;
+    prepareClassData(gt.groundtruths, detections, gt.cleaned[d], boxoverlap, metric, difficulty, depth, options.n_threads, data);
+
+    // OSPA does not depend on the overlap threshold, every level's rows get the same values
+    vector<tOspa> ospa;
+    if (options.ospa)
+      ospaFrames(gt.groundtruths, detections, data, metric, options.n_threads, ospa);
+    vector<tTpErrors> tp_errors;
+    if (metric == CENTER)
+      tpErrorFrames(gt.groundtruths, detections, data, options.n_threads, tp_errors);
+
+    for (int level : levels) {
+      CLASSES cls = (CLASSES)level;
+
+      string tag = levelTag(options, difficulty, metric, level);
+
+      // frames are matched once, the overall and per-sequence metrics are reductions of their records
+      tClassRecords records;
+      recordStatistics(gt.groundtruths, detections, data, MIN_OVERLAP[metric][level], false, options.n_threads, records);
+      if (options.verify >= 0)
+        verified &= verifyRecords(gt.groundtruths, detections, data, records, verify_subset, names, cls,
+                                  metric, difficulty, depth, tag, options.n_threads);
+
+      // eval image 2D bounding boxes, or 3D bounding boxes
+      vector<tEvalRow> rows;
+      if (depth && export_stats && difficulty == HARD && level == c) {
+        cout << "Starting 3D evaluation (" << CLASS_NAMES[level].c_str() << tag << ") ..." << endl;
+
+        // tp, fp and fn boxes are written for the requested overlap threshold on the hard level,
+        // which needs the per-box indices of a full pass
+        vector<double> precision_3d;
+        vector<double> recall_3d;
+        if (!eval_class(cls, gt.groundtruths, detections, false, boxoverlap, precision_3d, recall_3d, metric, difficulty, depth, true, options.n_threads, &data,
+                        options.export_path.empty() ? NULL : &exporter, options.export_path)) {
+          cout << CLASS_NAMES[level].c_str() << " evaluation failed." << endl;
+        } else {
+          rows.push_back(tEvalRow("overall" + tag, precision_3d, recall_3d));
+          if (metric == CENTER) {
+            rows.back().has_tp_errors = true;
+            rows.back().tp_errors = reduceTpErrors(tp_errors, 0, tp_errors.size());
+          }
+          if (options.ospa) {
+            rows.back().has_ospa = true;
+            rows.back().ospa = overallOspa(ospa, gt.seq_ranges);
+          }
+        }
+        recordRows(records, gt.seq_ranges, depth, level, tag, false, rows, &cout, options.ospa ? &ospa : NULL,
+                   metric == CENTER ? &tp_errors : NULL);
       } else {
-        result_path = result_dir + '/' + sequence + "/image_stitched/" + frame;
+        recordRows(records, gt.seq_ranges, depth, level, tag, true, rows, &cout, options.ospa ? &ospa : NULL,
+                   metric == CENTER ? &tp_errors : NULL);
       }
-      vector<tGroundtruth> gt = loadGroundtruth(gt_path);
-      vector<tDetection> det = loadDetection(result_path);
-      groundtruths.push_back(gt);
-      detections.push_back(det);
-
-      if (frame=="002308.txt") {
-        cout << "sequence " << sequence << " idx " << idx << '\n';
-        cout << "num boxes in frame " << frame << " gt size " << gt.size() << " dt size " << det.size() << '\n';
+      for (const tEvalRow &row : rows)
+        write_result(outfile, row);
+
+      // the interval follows the rows of its level, the overall row stays the first line
+      if (options.bootstrap > 0) {
+        auto start = chrono::steady_clock::now();
+        write_result(outfile, bootstrapRow(records, gt.seq_ranges, depth, "overall" + tag + "@ci95",
+                                           options.bootstrap, options.bootstrap_sequences, options.seed, options.n_threads));
+        cout << "Bootstrapped " << options.bootstrap << (options.bootstrap_sequences ? " sequence" : " frame")
+             << " resamples in " << secondsSince(start) << " s" << endl;
       }
-      //Build 1to1 map from groundtruths indices to frames in imagesets
-      size_t dotPosition = frame.find('.');
-      gtdetidx_to_frame_map[idx] = frame.substr(0, dotPosition);
-      ++idx;
+    }
+  }
+  exporter.finish();
+  return verified;
+}
+
+bool eval(string gt_dir, string result_dir, int c, bool depth, const tEvalOptions &options, ofstream& outfile) {
+  tGroundtruthSet gt;
+  loadGroundtruthSet(gt_dir, c, depth, options, gt);
+  tDetectionStore detections;
+  loadPredictions(result_dir, depth, options, gt.frames, detections);
+  return evalPredictions(gt, detections, c, depth, options, true, outfile);
+}
 
-      groundtruths_seq.push_back(gt);
-      detections_seq.push_back(det);
+// evaluates every prediction directory of the list file against one loaded ground truth. Every
+// line of the list holds "<name> <prediction dir>" (or only the directory, named by its line
+// no.), the metrics of each are written to out_dir/outfile<name>.txt. Prediction sets are loaded
+// and evaluated one after another with all threads, so only one of them is held in memory. A run
+// that fails (e.g. a missing prediction file) is reported to cerr, added to failed and gets no
+// outfile, the remaining runs are still evaluated.
+bool evalBatch(string gt_dir, string list_file, string out_dir, int c, bool depth, const tEvalOptions &options,
+        vector<string> &failed) {
+
+  vector<pair<string, string> > runs;
+  ifstream list(list_file);
+  if (!list)
+    throw invalid_argument("Cannot open batch list " + list_file);
+  string line;
+  while (getline(list, line)) {
+    istringstream fields(line);
+    string name, result_dir;
+    if (!(fields >> name))
+      continue;
+    if (!(fields >> result_dir)) {
+      result_dir = name;
+      name = to_string(runs.size() + 1);
     }
-    groundtruths_perseq[sequence] = groundtruths_seq;
-    detections_perseq[sequence] = detections_seq;
+    runs.push_back(make_pair(name, result_dir));
   }
-  cout << "Num gt files " << groundtruths.size() << endl;
-  if (groundtruths.size() != N_TESTIMAGES) {
-    throw invalid_argument("Mismatch in number of ground truth files.");
+  filesystem::create_directories(out_dir);
+
+  tGroundtruthSet gt;
+  loadGroundtruthSet(gt_dir, c, depth, options, gt);
+  bool verified = true;
+  for (const auto& run : runs) {
+    auto start = chrono::steady_clock::now();
+    cout << "Evaluating " << run.first << ": " << run.second << endl;
+    string outfile_path = out_dir + "/outfile" + run.first + ".txt";
+    try {
+      tDetectionStore detections;
+      loadPredictions(run.second, depth, options, gt.frames, detections);
+
+      // tp/fp/fn boxes of all runs would go to the same directory, so they are only exported to
+      // one archive per run, <export path>.<name>
+      ofstream outfile(outfile_path);
+      tEvalOptions run_options(options);
+      if (!options.export_path.empty())
+        run_options.export_path = options.export_path + "." + run.first;
+      verified &= evalPredictions(gt, detections, c, depth, run_options, !options.export_path.empty(), outfile);
+    } catch (const exception &e) {
+      cerr << "Evaluation of " << run.first << " (" << run.second << ") failed: " << e.what() << endl;
+      remove(outfile_path.c_str());
+      failed.push_back(run.first);
+      continue;
+    }
+    cout << "Saved metrics of " << run.first << " in " << secondsSince(start) << " s" << endl;
   }
+  return verified;
+}
 
-  cout << "Loaded data" << endl;
+/*=======================================================================
+STREAMING EVALUATION
+=======================================================================*/
+
+// evaluates frames as they are produced, e.g. inside a validation loop, without label files. Each
+// frame is cleaned, matched and reduced to its records (per evaluated difficulty and overlap
+// threshold) by add_frame, its boxes are not kept. finalize reduces the records as evalPredictions
+// does, so the rows equal those of the batch evaluation of the same frames. Not thread-safe.
+class tStreamingEval {
+public:
+  // evaluates the levels of threshold c (all of them with options.all_levels) in 2D or 3D (depth)
+  tStreamingEval (int c, bool depth, const tEvalOptions &options = tEvalOptions()) :
+    depth(depth), options(options), metric(depth ? (options.center ? CENTER : BOX3D) : IMAGE),
+    boxoverlap(depth ? box3DOverlap : NULL), n_frames(0) {
+    initGlobals();
+    if (!depth)
+      boxoverlap = imageBoxOverlap;
+    else if (options.center)
+      boxoverlap = centerOverlap;
+    evalLevels(c, options, difficulties, levels);
+    records.assign(difficulties.size(), vector<tClassRecords>(levels.size()));
+    ospa.resize(options.ospa ? difficulties.size() : 0);
+    tp_errors.resize(metric == CENTER ? difficulties.size() : 0);
+  }
 
-  CLASSES cls = (CLASSES)c;
+  // adds the next frame of sequence, the frames of a sequence must be added one after another
+  void add_frame (const string &sequence, const vector<tGroundtruth> &gt, const vector<tDetection> &det) {
+    add_frame(sequence, tSpan<tGroundtruth>(gt.data(), gt.size()), tSpan<tDetection>(det.data(), det.size()));
+  }
 
-  // eval image 2D bounding boxes
-  if (!depth) {
-    cout << "Starting 2D evaluation (" << CLASS_NAMES[c].c_str() << ") ..." << endl;
-    vector<double> precision_2d_hard;
-    if (!eval_class(cls, groundtruths, detections, false, imageBoxOverlap, precision_2d_hard, IMAGE, HARD, depth)) {
-      cout << CLASS_NAMES[c].c_str() << " evaluation failed." << endl;
-    } else {
-      write_result(outfile, "overall", precision_2d_hard);
-    }
-    for (auto const& groundtruths_seq : groundtruths_perseq) {
-      cout << "Starting per-sequence 2D evaluation (" << groundtruths_seq.first << ", " << CLASS_NAMES[c].c_str() << ") ..." << endl;
-      vector<double> precision_2d_seq;
-      if (!eval_class(cls, groundtruths_seq.second, detections_perseq[groundtruths_seq.first], false, imageBoxOverlap, precision_2d_seq, IMAGE, HARD, depth)) {
-        cout << CLASS_NAMES[c].c_str() << " evaluation failed." << endl;
-      } else {
-        write_result(outfile, groundtruths_seq.first, precision_2d_seq);
-      }
+  void add_frame (const string &sequence, tSpan<tGroundtruth> gt_frame, tSpan<tDetection> det_frame) {
+    if (sequence != last_sequence) {
+      if (seq_ranges.count(sequence))
+        throw invalid_argument("frames of sequence " + sequence + " must be added one after another");
+      seq_ranges[sequence] = make_pair(n_frames, n_frames);
+      last_sequence = sequence;
     }
-  } else {
-    cout << "Starting 3D evaluation (" << CLASS_NAMES[c].c_str() << ") ..." << endl;
-    
-    // vector<double> precision_3d_easy;
-    // vector<double> recall_3d_easy;
-    // if (!eval_class(cls, groundtruths, detections, false, box3DOverlap, precision_3d_easy, recall_3d_easy, BOX3D, EASY, depth)) {
-    //     cout << CLASS_NAMES[c].c_str() << " evaluation failed." << endl;
-    //   } else {
-    //     write_result(outfile, "overall", precision_3d_easy, recall_3d_easy);
-    //   }
-    //   for (auto const& groundtruths_seq : groundtruths_perseq) {
-    //     cout << "Starting per-sequence 3D evaluation (" << groundtruths_seq.first << ", " << CLASS_NAMES[c].c_str() << ") ..." << endl;
-    //     vector<double> precision_3d_seq;
-    //     vector<double> recall_3d_seq;
-    //     if (!eval_class(cls, groundtruths_seq.second, detections_perseq[groundtruths_seq.first], false, box3DOverlap, precision_3d_seq, recall_3d_seq, BOX3D, EASY, depth)) {
-    //       cout << CLASS_NAMES[c].c_str() << " evaluation failed." << endl;
-    //     } else {
-    //       write_result(outfile, groundtruths_seq.first, precision_3d_seq, recall_3d_seq);
-    //     }
-    //   }
-    // }
-    
-    vector<double> precision_3d_hard;
-    vector<double> recall_3d_hard;
-    if (!eval_class(cls, groundtruths, detections, false, box3DOverlap, precision_3d_hard, recall_3d_hard, BOX3D, HARD, depth, true)) {
-      cout << CLASS_NAMES[c].c_str() << " evaluation failed." << endl;
-    } else {
-      write_result(outfile, "overall", precision_3d_hard, recall_3d_hard);
-    }
-    for (auto const& groundtruths_seq : groundtruths_perseq) {
-      cout << "Starting per-sequence 3D evaluation (" << groundtruths_seq.first << ", " << CLASS_NAMES[c].c_str() << ") ..." << endl;
-      vector<double> precision_3d_seq;
-      vector<double> recall_3d_seq;
-      if (!eval_class(cls, groundtruths_seq.second, detections_perseq[groundtruths_seq.first], false, box3DOverlap, precision_3d_seq, recall_3d_seq, BOX3D, HARD, depth)) {
-        cout << CLASS_NAMES[c].c_str() << " evaluation failed." << endl;
-      } else {
-        write_result(outfile, groundtruths_seq.first, precision_3d_seq, recall_3d_seq);
+
+    for (size_t d = 0; d < difficulties.size(); d++) {
+      CLASSES tmp_1 = (CLASSES)1;
+      vector<int32_t> ignored_gt, dc, ignored_det;
+      int32_t n_gt = 0;
+      cleanGroundtruth(tmp_1, gt_frame, ignored_gt, dc, n_gt, difficulties[d], depth);
+      cleanDetections(tmp_1, det_frame, ignored_det, difficulties[d], depth);
+      tFrameOverlaps overlaps = withOverlap(boxoverlap, metric, [&](const auto &overlap) {
+        return computeFrameOverlaps(gt_frame, det_frame, dc, ignored_gt, ignored_det, overlap, metric);
+      });
+      if (options.ospa)
+        ospa[d].push_back(ospaFrame(gt_frame, det_frame, ignored_gt, ignored_det, overlaps, metric));
+      if (metric == CENTER)
+        tp_errors[d].push_back(frameTpErrors(gt_frame, det_frame, ignored_gt, ignored_det, overlaps));
+      for (size_t l = 0; l < levels.size(); l++) {
+        records[d][l].frames.push_back(tFrameRecord());
+        recordFrame(gt_frame, det_frame, ignored_gt, n_gt, ignored_det, overlaps,
+                    MIN_OVERLAP[metric][levels[l]], false, records[d][l].frames.back());
       }
     }
+    seq_ranges[sequence].second = ++n_frames;
   }
-  
-}
+
+  // rows of all evaluated levels over the frames added so far, in the order of the output file.
+  // Nothing is written to stdout, so it can run inside a training loop.
+  vector<tEvalRow> finalize () const {
+    vector<tEvalRow> rows;
+    for (size_t d = 0; d < difficulties.size(); d++)
+      for (size_t l = 0; l < levels.size(); l++)
+        recordRows(records[d][l], seq_ranges, depth, levels[l],
+                   levelTag(options, difficulties[d], metric, levels[l]), true, rows, NULL,
+                   options.ospa ? &ospa[d] : NULL, metric == CENTER ? &tp_errors[d] : NULL);
+    return rows;
+  }
+
+  // writes the rows as the batch evaluation writes its output file
+  void finalize (ostream &outfile) const {
+    for (const tEvalRow &row : finalize())
+      write_result(outfile, row);
+  }
+
+  size_t size () const { return n_frames; }
+
+private:
+  bool                                depth;
+  tEvalOptions                        options;
+  METRIC                              metric;
+  double (*boxoverlap)(const tDetection&, const tGroundtruth&, int32_t);
+  vector<DIFFICULTY>                  difficulties;
+  vector<int>                         levels;
+  vector< vector<tClassRecords> >     records;      // records per difficulty and level
+  vector< vector<tOspa> >             ospa;         // per-frame OSPA per difficulty, with options.ospa
+  vector< vector<tTpErrors> >         tp_errors;    // per-frame TP errors per difficulty, CENTER only
+  map<string, pair<size_t, size_t> > seq_ranges;   // frames of each sequence
+  string                              last_sequence;
+  size_t                              n_frames;
+};
 
 // 2D USAGE: ./evaluate_object /path/to/groundtruth /path/to/prediction 0 outfile.txt 0 # iou threshold 0.3
 // 2D USAGE: ./evaluate_object /path/to/groundtruth /path/to/prediction 0 outfile.txt 1 # iou threshold 0.5
@@ -1200,25 +4830,114 @@ void eval(string gt_dir, string result_dir, int c, bool depth, ofstream& outfile
 // 3D USAGE: ./evaluate_object /path/to/groundtruth /path/to/prediction 1 outfile.txt 1 # iou threshold 0.5
 // 3D USAGE: ./evaluate_object /path/to/groundtruth /path/to/prediction 1 outfile.txt 2 # iou threshold 0.7
 
+// OPTIONS: --cache # read/write binary label caches next to the ground truth and prediction directories
+// OPTIONS: --threads=N # no. of worker threads (default: all cores)
+// OPTIONS: --all # evaluate all overlap thresholds on the easy and hard level, rows are tagged name@level@iou
+// OPTIONS: --batch # result_dir is a list of "<name> <prediction dir>" lines, save_path a directory for outfile<name>.txt
+// OPTIONS: --export=PATH # write the tp/fp/fn boxes to the single archive PATH (PATH.<name> with --batch) in the background
+// OPTIONS: --json # gt_dir is a JRDB labels directory and result_dir holds <sequence>.json predictions, no conversion needed
+// OPTIONS: --ospa # append OSPA and its cardinality and localization terms to every row after AP (and AR, F1)
+// OPTIONS: --bootstrap=N # add an overall@ci95 row with the 95% interval of AP (and AR, F1) from N resamples of the frames
+// OPTIONS: --bootstrap-sequences # resample whole sequences instead of frames
+// OPTIONS: --seed=S # seed of the resamples (default: 0)
+// OPTIONS: --verify[=N] # check the fast engine against the boost/greedy reference on all (N random) frames, exit code 2 on a mismatch
+// OPTIONS: --profile=PATH # write a Chrome trace of the stages and frames to PATH and print a summary table
+// OPTIONS: --center # 3D: match on the ground plane center distance (2/1/0.5 m for threshold 0/1/2) and add mATE,mASE,mAOE
+
+#ifndef EVALUATE_OBJECT_LIBRARY
 int32_t main (int32_t argc, char *argv[]) {
-  if (argc != 6) {
-    cout << "Usage: ./eval_detection gt_dir result_dir eval_type save_path threshold" << endl;
+  if (argc < 6) {
+    cout << "Usage: ./eval_detection gt_dir result_dir eval_type save_path threshold [--cache] [--threads=N] [--all] [--batch] [--export=PATH] [--json] [--ospa] [--bootstrap=N] [--bootstrap-sequences] [--seed=S] [--profile=PATH] [--verify[=N]] [--center]" << endl;
     return 1;
   }
   initGlobals();
 
-  vector<vector<tGroundtruth>> groundtruths;
-  vector<vector<tDetection>> detections;
+  // optional flags after the positional arguments
+  tEvalOptions options;
+  for (int32_t k = 6; k < argc; k++) {
+    if (!strcmp(argv[k], "--cache")) {
+      options.use_cache = true;
+    } else if (!strcmp(argv[k], "--all")) {
+      options.all_levels = true;
+    } else if (!strcmp(argv[k], "--batch")) {
+      options.batch = true;
+    } else if (!strcmp(argv[k], "--json")) {
+      options.json = true;
+    } else if (!strcmp(argv[k], "--ospa")) {
+      options.ospa = true;
+    } else if (!strcmp(argv[k], "--center")) {
+      options.center = true;
+    } else if (!strncmp(argv[k], "--bootstrap=", 12) && atoi(argv[k] + 12) > 0) {
+      options.bootstrap = atoi(argv[k] + 12);
+    } else if (!strcmp(argv[k], "--bootstrap-sequences")) {
+      options.bootstrap_sequences = true;
+    } else if (!strncmp(argv[k], "--seed=", 7) && argv[k][7]) {
+      options.seed = strtoul(argv[k] + 7, NULL, 10);
+    } else if (!strcmp(argv[k], "--verify")) {
+      options.verify = 0;
+    } else if (!strncmp(argv[k], "--verify=", 9) && atoi(argv[k] + 9) > 0) {
+      options.verify = atoi(argv[k] + 9);
+    } else if (!strncmp(argv[k], "--profile=", 10) && argv[k][10]) {
+      options.profile_path = argv[k] + 10;
+    } else if (!strncmp(argv[k], "--export=", 9) && argv[k][9]) {
+      options.export_path = argv[k] + 9;
+    } else if (!strncmp(argv[k], "--threads=", 10) && atoi(argv[k] + 10) > 0) {
+      options.n_threads = atoi(argv[k] + 10);
+    } else {
+      cout << "Unknown option " << argv[k] << endl;
+      return 1;
+    }
+  }
 
   bool depth = strcmp(argv[3], "0") != 0;
+  if (options.center && (!depth || options.ospa)) {
+    cout << "--center needs a 3D evaluation and excludes --ospa" << endl;
+    return 1;
+  }
+  if (!options.profile_path.empty())
+    tProfiler::get().enable();
+
+  bool verified;
+  vector<string> failed;
+  {
+    tScopedTimer timer("run");
+    if (options.batch) {
+      // run evaluation of all listed prediction directories
+      verified = evalBatch(argv[1], argv[2], argv[4], atoi(argv[5]), depth, options, failed);
+      cout << "Finished evaluating" << endl;
+    } else {
+      // run evaluation
+      ofstream outfile;
+      outfile.open(argv[4]);
+      int i= atoi(argv[5]);
+      try {
+        verified = eval(argv[1], argv[2], i, depth, options, outfile);
+      } catch (const exception &e) {
+        cerr << "Evaluation failed: " << e.what() << endl;
+        return 1;
+      }
+      cout << "Finished evaluating" << endl;
+      outfile.close();
+      cout << "Saved metrics to " << argv[4] << endl;
+    }
+  }
 
-  // run evaluation
-  ofstream outfile;
-  outfile.open(argv[4]);
-  int i= atoi(argv[5]);
-  eval(argv[1], argv[2], i, depth, outfile);
-  cout << "Finished evaluating" << endl;
-  outfile.close();
-  cout << "Saved metrics to " << argv[4] << endl;
+  if (!options.profile_path.empty()) {
+    tProfiler::get().writeTrace(options.profile_path);
+    tProfiler::get().writeSummary(cout);
+    cout << "Saved trace to " << options.profile_path << endl;
+  }
+  if (!failed.empty()) {
+    cerr << failed.size() << " batch run(s) failed:";
+    for (const string &name : failed)
+      cerr << ' ' << name;
+    cerr << endl;
+    return 1;
+  }
+  if (!verified) {
+    cout << "Verification against the reference evaluation failed" << endl;
+    return 2;
+  }
   return 0;
 }
+#endif // EVALUATE_OBJECT_LIBRARY
@@ -0,0 +1,144 @@
+// C interface of the streaming evaluation, see evaluate_object_c.h
+#define EVALUATE_OBJECT_LIBRARY
+#include "evaluate_object.cpp"
+#include "evaluate_object_c.h"
+
+struct jrdb_eval {
+  tStreamingEval       eval;
+  vector<tEvalRow>     rows;    // rows of the last finalize
+  vector<tGroundtruth> gt;      // boxes of the current frame, reused for every frame
+  vector<tDetection>   det;
+  mutable string       error;
+  jrdb_eval (int threshold, bool depth, const tEvalOptions &options) :
+    eval(threshold, depth, options) {}
+};
+
+// failure of a call without a handle
+static thread_local string last_error;
+
+// runs fn and turns an exception into -1 and the error message of eval
+template <typename F>
+static int guarded(string &error, F fn) {
+  try {
+    fn();
+    return 0;
+  } catch (const exception &e) {
+    error = e.what();
+  } catch (...) {
+    error = "unknown error";
+  }
+  return -1;
+}
+
+extern "C" {
+
+jrdb_eval *jrdb_eval_create (int threshold, int depth, int all_levels) {
+  jrdb_eval *eval = NULL;
+  guarded(last_error, [&]() {
+    if (threshold < 0 || threshold >= NUM_CLASS)
+      throw invalid_argument("threshold index must be 0, 1 or 2");
+    tEvalOptions options;
+    options.all_levels = all_levels != 0;
+    eval = new jrdb_eval(threshold, depth != 0, options);
+  });
+  return eval;
+}
+
+void jrdb_eval_destroy (jrdb_eval *eval) {
+  delete eval;
+}
+
+int32_t jrdb_eval_class_id (const char *name) {
+  int32_t id = -1;
+  guarded(last_error, [&]() { id = internClass(name); });
+  return id;
+}
+
+int jrdb_eval_add_frames (jrdb_eval *eval, size_t n_frames, const char *const *sequences,
+                          const int64_t *gt_offsets, const int32_t *gt_types, const double *gt,
+                          const int64_t *det_offsets, const int32_t *det_types, const double *det) {
+  if (!eval) {
+    last_error = "no evaluator";
+    return -1;
+  }
+  return guarded(eval->error, [&]() {
+    if (gt_offsets[0] < 0 || det_offsets[0] < 0)
+      throw invalid_argument("box offsets must not be negative");
+    size_t n_types;
+    {
+      lock_guard<mutex> lock(classTable().m);
+      n_types = classTable().names.size();
+    }
+    for (size_t i = 0; i < n_frames; i++) {
+      if (gt_offsets[i] > gt_offsets[i+1] || det_offsets[i] > det_offsets[i+1])
+        throw invalid_argument("box offsets must not decrease");
+
+      eval->gt.clear();
+      for (int64_t k = gt_offsets[i]; k < gt_offsets[i+1]; k++) {
+        const double *r = gt + k * JRDB_EVAL_GT_COLS;
+        if (gt_types[k] < 0 || (size_t)gt_types[k] >= n_types)
+          throw invalid_argument("unknown object type id " + to_string(gt_types[k]));
+        tGroundtruth g(tBox((tClassId)gt_types[k], r[4], r[5], r[6], r[7], r[3]), (int32_t)r[0], (int32_t)r[1]);
+        g.num_points_3d = (int32_t)r[2];
+        g.l = r[8];  g.h = r[9];   g.w = r[10];
+        g.t1 = r[11]; g.t2 = r[12]; g.t3 = r[13];
+        g.ry = r[14];
+        eval->gt.push_back(g);
+      }
+
+      eval->det.clear();
+      for (int64_t k = det_offsets[i]; k < det_offsets[i+1]; k++) {
+        const double *r = det + k * JRDB_EVAL_DET_COLS;
+        if (det_types[k] < 0 || (size_t)det_types[k] >= n_types)
+          throw invalid_argument("unknown object type id " + to_string(det_types[k]));
+        tDetection d(tBox((tClassId)det_types[k], r[1], r[2], r[3], r[4], r[0]), r[12]);
+        d.l = r[5];  d.h = r[6];  d.w = r[7];
+        d.t1 = r[8]; d.t2 = r[9]; d.t3 = r[10];
+        d.ry = r[11];
+        eval->det.push_back(d);
+      }
+
+      eval->eval.add_frame(sequences[i], eval->gt, eval->det);
+    }
+  });
+}
+
+int64_t jrdb_eval_finalize (jrdb_eval *eval) {
+  if (!eval) {
+    last_error = "no evaluator";
+    return -1;
+  }
+  if (guarded(eval->error, [&]() { eval->rows = eval->eval.finalize(); }) != 0)
+    return -1;
+  return eval->rows.size();
+}
+
+int jrdb_eval_row (const jrdb_eval *eval, int64_t k, const char **name,
+                   double *ap, double *ar, double *f1,
+                   const double **precision, size_t *n_precision,
+                   const double **recall, size_t *n_recall) {
+  if (!eval) {
+    last_error = "no evaluator";
+    return -1;
+  }
+  if (k < 0 || (size_t)k >= eval->rows.size()) {
+    eval->error = "no row " + to_string(k);
+    return -1;
+  }
+  const tEvalRow &row = eval->rows[k];
+  *name = row.name.c_str();
+  *ap = row.ap;
+  *ar = row.ar;
+  *f1 = row.f1;
+  *precision = row.precision.data();
+  *n_precision = row.precision.size();
+  *recall = row.recall.data();
+  *n_recall = row.recall.size();
+  return 0;
+}
+
+const char *jrdb_eval_last_error (const jrdb_eval *eval) {
+  return eval ? eval->error.c_str() : last_error.c_str();
+}
+
+}
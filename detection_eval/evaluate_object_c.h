@@ -0,0 +1,65 @@
+/*
+ * C interface of the streaming evaluation (tStreamingEval in evaluate_object.cpp), built as a
+ * shared library:
+ *
+ *   g++ -O3 -std=c++17 -pthread -shared -fPIC -o libevaluate_object.so evaluate_object_c.cpp
+ *
+ * Boxes are passed as flat row-major double arrays of all frames, frame i owns the rows
+ * [offsets[i], offsets[i+1]). The columns follow the label files (without the object type,
+ * which is passed as an id from jrdb_eval_class_id):
+ *
+ *   ground truth: truncation occlusion num_points_3d alpha x1 y1 x2 y2 l h w t1 t2 t3 ry
+ *   detections:   alpha x1 y1 x2 y2 l h w t1 t2 t3 ry score
+ *
+ * The arrays are only read during the call. Functions returning int return 0 on success and -1 on
+ * failure, jrdb_eval_last_error then describes the failure.
+ */
+#ifndef EVALUATE_OBJECT_C_H
+#define EVALUATE_OBJECT_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JRDB_EVAL_GT_COLS  15
+#define JRDB_EVAL_DET_COLS 13
+
+typedef struct jrdb_eval jrdb_eval;
+
+/* evaluation of overlap threshold index threshold (0: 0.3, 1: 0.5, 2: 0.7) in 2D (depth 0) or
+   3D, of every threshold and difficulty if all_levels is set. NULL on failure. */
+jrdb_eval *jrdb_eval_create (int threshold, int depth, int all_levels);
+void jrdb_eval_destroy (jrdb_eval *eval);
+
+/* id of an object type (e.g. "pedestrian", "dontcare"), matched case-insensitively */
+int32_t jrdb_eval_class_id (const char *name);
+
+/* adds n_frames frames, frame i of sequence sequences[i]; the frames of a sequence must be added
+   one after another, in one or several calls. Offsets must be non-negative and must not decrease. */
+int jrdb_eval_add_frames (jrdb_eval *eval, size_t n_frames, const char *const *sequences,
+                          const int64_t *gt_offsets, const int32_t *gt_types, const double *gt,
+                          const int64_t *det_offsets, const int32_t *det_types, const double *det);
+
+/* computes the rows of the frames added so far (as written to the output file), returns their no.
+   or -1 on failure. The rows stay valid until the next call of finalize or destroy. */
+int64_t jrdb_eval_finalize (jrdb_eval *eval);
+
+/* row k of the last finalize: name, AP, AR and F1 (AR and F1 are 0 for 2D) and the precision and
+   recall arrays (recall is empty for 2D) */
+int jrdb_eval_row (const jrdb_eval *eval, int64_t k, const char **name,
+                   double *ap, double *ar, double *f1,
+                   const double **precision, size_t *n_precision,
+                   const double **recall, size_t *n_recall);
+
+/* message of the last failure of eval (of create, class_id or a call with a NULL handle if eval is
+   NULL) */
+const char *jrdb_eval_last_error (const jrdb_eval *eval);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EVALUATE_OBJECT_C_H */
@@ -0,0 +1,102 @@
+"""ctypes binding of libevaluate_object.so (see evaluate_object_c.h).
+
+Evaluates numpy box arrays directly, without writing KITTI label files:
+
+    ev = StreamingEval('./libevaluate_object.so', threshold=0, depth=True)
+    ev.add_frames(sequences, gt_offsets, gt_types, gt, det_offsets, det_types, det)
+    for name, ap, ar, f1, precision, recall in ev.finalize():
+        ...
+
+gt and det are (n, GT_COLS) and (n, DET_COLS) float64 arrays with the label file columns,
+frame i owns rows offsets[i]:offsets[i+1]. C-contiguous float64/int64/int32 arrays are
+passed without copying.
+"""
+import ctypes
+
+import numpy as np
+
+GT_COLS = 15   # truncation occlusion num_points_3d alpha x1 y1 x2 y2 l h w t1 t2 t3 ry
+DET_COLS = 13  # alpha x1 y1 x2 y2 l h w t1 t2 t3 ry score
+
+_c_double_p = ctypes.POINTER(ctypes.c_double)
+
+
+def _load(path):
+    lib = ctypes.CDLL(path)
+    lib.jrdb_eval_create.restype = ctypes.c_void_p
+    lib.jrdb_eval_create.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.jrdb_eval_destroy.argtypes = [ctypes.c_void_p]
+    lib.jrdb_eval_class_id.restype = ctypes.c_int32
+    lib.jrdb_eval_class_id.argtypes = [ctypes.c_char_p]
+    lib.jrdb_eval_add_frames.argtypes = [
+        ctypes.c_void_p, ctypes.c_size_t, ctypes.POINTER(ctypes.c_char_p),
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p,
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+    lib.jrdb_eval_finalize.restype = ctypes.c_int64
+    lib.jrdb_eval_finalize.argtypes = [ctypes.c_void_p]
+    lib.jrdb_eval_row.argtypes = [
+        ctypes.c_void_p, ctypes.c_int64, ctypes.POINTER(ctypes.c_char_p),
+        _c_double_p, _c_double_p, _c_double_p,
+        ctypes.POINTER(_c_double_p), ctypes.POINTER(ctypes.c_size_t),
+        ctypes.POINTER(_c_double_p), ctypes.POINTER(ctypes.c_size_t)]
+    lib.jrdb_eval_last_error.restype = ctypes.c_char_p
+    lib.jrdb_eval_last_error.argtypes = [ctypes.c_void_p]
+    return lib
+
+
+class StreamingEval(object):
+    """Frames are added in batches, the rows of the output file are computed by finalize."""
+
+    def __init__(self, lib_path, threshold, depth, all_levels=False):
+        self._lib = _load(lib_path)
+        self._eval = self._lib.jrdb_eval_create(threshold, int(depth), int(all_levels))
+        if not self._eval:
+            raise ValueError(self._lib.jrdb_eval_last_error(None).decode())
+
+    def __del__(self):
+        if getattr(self, '_eval', None):
+            self._lib.jrdb_eval_destroy(self._eval)
+            self._eval = None
+
+    def class_id(self, name):
+        return self._lib.jrdb_eval_class_id(name.encode())
+
+    def _check(self, status):
+        if status < 0:
+            raise RuntimeError(self._lib.jrdb_eval_last_error(self._eval).decode())
+        return status
+
+    def add_frames(self, sequences, gt_offsets, gt_types, gt, det_offsets, det_types, det):
+        """Adds len(sequences) frames, types are ids from class_id."""
+        arrays = [np.ascontiguousarray(gt_offsets, dtype=np.int64),
+                  np.ascontiguousarray(gt_types, dtype=np.int32),
+                  np.ascontiguousarray(gt, dtype=np.float64).reshape(-1, GT_COLS),
+                  np.ascontiguousarray(det_offsets, dtype=np.int64),
+                  np.ascontiguousarray(det_types, dtype=np.int32),
+                  np.ascontiguousarray(det, dtype=np.float64).reshape(-1, DET_COLS)]
+        n_frames = len(sequences)
+        for offsets, types, boxes in (arrays[0:3], arrays[3:6]):
+            if len(offsets) != n_frames + 1 or offsets[-1] > len(types) or len(types) != len(boxes):
+                raise ValueError('offsets, types and boxes do not match')
+        names = (ctypes.c_char_p * n_frames)(*[s.encode() for s in sequences])
+        self._check(self._lib.jrdb_eval_add_frames(
+            self._eval, n_frames, names, *[a.ctypes.data for a in arrays]))
+
+    def finalize(self):
+        """Rows (name, ap, ar, f1, precision, recall) of the frames added so far."""
+        rows = []
+        for k in range(self._check(self._lib.jrdb_eval_finalize(self._eval))):
+            name = ctypes.c_char_p()
+            ap, ar, f1 = ctypes.c_double(), ctypes.c_double(), ctypes.c_double()
+            precision, recall = _c_double_p(), _c_double_p()
+            n_precision, n_recall = ctypes.c_size_t(), ctypes.c_size_t()
+            self._check(self._lib.jrdb_eval_row(
+                self._eval, k, ctypes.byref(name), ctypes.byref(ap), ctypes.byref(ar),
+                ctypes.byref(f1), ctypes.byref(precision), ctypes.byref(n_precision),
+                ctypes.byref(recall), ctypes.byref(n_recall)))
+            rows.append((name.value.decode(), ap.value, ar.value, f1.value,
+                         np.ctypeslib.as_array(precision, (n_precision.value,)).copy()
+                         if n_precision.value else np.zeros(0),
+                         np.ctypeslib.as_array(recall, (n_recall.value,)).copy()
+                         if n_recall.value else np.zeros(0)))
+        return rows
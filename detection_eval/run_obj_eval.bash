@@ -22,12 +22,24 @@ if ! [[ "$epoch" =~ ^[0-9]+$ ]]; then
     fi
 fi
 
+# evaluating all epochs (--batch) needs an evaluate_object built from the current evaluate_object.cpp (see README.md)
+if [ "$epoch" -eq 0 ] && ! grep -q -a -e '--batch' ./evaluate_object 2>/dev/null; then
+    echo "./evaluate_object is missing or too old for --batch, build it first:"
+    echo "  g++ -O3 -std=c++17 -pthread -o evaluate_object evaluate_object.cpp"
+    exit 1
+fi
+
 # Check if the output directory exists, and create it if not
 if [ ! -d "$output_directory" ]; then
     mkdir -p "$output_directory"
     echo "Created output directory: $output_directory"
 fi
 
+# fingerprint of a label tree from its listing and file sizes, without reading the files
+tree_fingerprint() {
+    (cd "$1" && find . -type f -printf '%P %s\n' | LC_ALL=C sort | md5sum)
+}
+
 # Function to evaluate an epoch
 evaluate_epoch() {
     local epoch=$1
@@ -47,19 +59,35 @@ evaluate_epoch() {
 
 if [ "$epoch" -eq 0 ]; then
     echo "Evaluating all epochs"
-    # Maximum number of concurrent threads
-    max_threads=8
-
-    # Iterate through all epochs
+    # The ground truth is normally the same for all epochs, so it is loaded once from
+    # epoch_1 and every epoch's predictions are evaluated against it by a single batch
+    # run. An epoch whose ground truth differs from epoch_1 (in its file names or sizes)
+    # is evaluated on its own against its own ground truth, as before.
+    gt_directory="$input_directory/epoch_1/val/final_result/data/jrdb_gt"
+    batch_list="$output_directory/epochs.txt"
+    separate_epochs=()
+    gt_fingerprint=$(tree_fingerprint "$gt_directory")
+    : > "$batch_list"
     for epoch in $(seq 1 30); do
-        # Start a new thread to evaluate the current epoch
-        evaluate_epoch "$epoch" &
-
-        # Limit the number of concurrent threads
-        if [ $(jobs -r -p | wc -l) -ge "$max_threads" ]; then
-            wait -n
+        epoch_gt="$input_directory/epoch_$epoch/val/final_result/data/jrdb_gt"
+        if [ -d "$epoch_gt" ] && [ "$(tree_fingerprint "$epoch_gt")" != "$gt_fingerprint" ]; then
+            echo "Ground truth of epoch $epoch differs from epoch_1, evaluating it separately"
+            separate_epochs+=("$epoch")
+        else
+            echo "$epoch $input_directory/epoch_$epoch/val/final_result/data/jrdb_preds" >> "$batch_list"
         fi
     done
+
+    # a failed epoch is reported and skipped, the remaining epochs are still evaluated
+    status=0
+    ./evaluate_object "$gt_directory" "$batch_list" 1 "$output_directory" 0 --batch || status=1
+    for epoch in "${separate_epochs[@]}"; do
+        evaluate_epoch "$epoch" || status=1
+    done
+    if [ $status -ne 0 ]; then
+        echo "Evaluation of some epochs failed."
+        exit 1
+    fi
 else
     evaluate_epoch "$epoch"
 fi